@@ -26,10 +26,16 @@ namespace stencil{
 		size_t buffer_size;
 		Elem* storage;
 
+		// time step of the current state, it lives in the copy (time % copies)
+		unsigned time;
+
+		// read-only fields, stored once after the copies (see attach)
+		unsigned auxiliaries;
+
 // ~~~~~~~~~~~~~~~~~~~~~~~ Canonical  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 		BufferSet(const std::array<size_t, Dimensions>& dimension_sizes, const std::vector<Elem>& data)
-			: dimension_sizes(dimension_sizes) 
+			: dimension_sizes(dimension_sizes), time(0), auxiliaries(0)
 		{ 
 			buffer_size = 1;
 			for (auto i = 0; i < Dimensions; ++i)  buffer_size *= dimension_sizes[i];
@@ -41,7 +47,7 @@ namespace stencil{
 		}
 
 		BufferSet(const std::array<size_t, Dimensions>& dimension_sizes, const Elem* data)
-			: dimension_sizes(dimension_sizes) 
+			: dimension_sizes(dimension_sizes), time(0), auxiliaries(0)
 		{ 
 			buffer_size = 1;
 			for (auto i = 0; i < Dimensions; ++i)  buffer_size *= dimension_sizes[i];
@@ -54,9 +60,10 @@ namespace stencil{
 		BufferSet(const BufferSet<Elem, Dimensions, Copies>& o) = delete;
 		
 		BufferSet(BufferSet<Elem, Dimensions, Copies>&& o)
-		: dimension_sizes(o.dimension_sizes), buffer_size(o.buffer_size), storage(nullptr)
+		: dimension_sizes(o.dimension_sizes), buffer_size(o.buffer_size), storage(nullptr), time(o.time), auxiliaries(o.auxiliaries)
 		{ 
 			o.buffer_size = 0;
+			o.auxiliaries = 0;
 			std::swap(storage, o.storage);
 		}
 
@@ -70,10 +77,31 @@ namespace stencil{
 			return storage + buffer_size*copy;
 		}
 
+		unsigned getTime() const{
+			return time;
+		}
+
+		void setTime(unsigned t){
+			time = t;
+		}
+
+		unsigned getCurrentCopy() const{
+			return time % copies;
+		}
+
+		Elem* getCurrentPointer(){
+			return getPointer(getCurrentCopy());
+		}
+
 		unsigned getSize(){
 			return buffer_size;
 		}
 
+		const Elem* getAuxPointer(unsigned field) const{
+			assert(field < auxiliaries && "no such field");
+			return storage + buffer_size*(copies + field);
+		}
+
 		Hyperspace<dimensions> getGlobalHyperspace(){
 
 			std::array<int, dimensions> a;
@@ -91,14 +119,37 @@ namespace stencil{
 			return Hyperspace<dimensions> (a, b, da, db);
 		}
 
+// ~~~~~~~~~~~~~~~~~~~~~~~ Read-only fields ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+		/**
+		 * Attaches a read-only field with the shape of the buffer, e.g. a coefficient per point.
+		 * It is stored once, after the time copies and with their layout, and kernels read
+		 * it with getAux. Returns the index of the field
+		 */
+		unsigned attach(const Elem* values){
+
+			Elem* grown = new Elem[buffer_size*(copies + auxiliaries + 1)];
+			memcpy(grown, storage, buffer_size*(copies + auxiliaries) * sizeof(Elem));
+			memcpy(grown + buffer_size*(copies + auxiliaries), values, buffer_size * sizeof(Elem));
+			delete[] storage;
+			storage = grown;
+			return auxiliaries++;
+		}
+
+		unsigned attach(const std::vector<Elem>& values){
+			assert(values.size() >= buffer_size && "field smaller than the buffer");
+			return attach(values.data());
+		}
+
 // ~~~~~~~~~~~~~~~~~~~~~~~ Comparison ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 		bool operator == (const BufferSet<Elem, Dimensions, Copies>& o){
 
 			if (buffer_size != o.buffer_size) return false;
+			if (auxiliaries != o.auxiliaries) return false;
 
-			for (int c=0; c < Copies; ++c){
-				for ( auto i = 0; i< buffer_size; ++i) {
+			for (unsigned c=0; c < Copies + auxiliaries; ++c){
+				for ( size_t i = 0; i< buffer_size; ++i) {
 					if (storage[c*buffer_size + i] != o.storage[c*buffer_size + i]){
 						return false;
 					}
@@ -178,6 +229,54 @@ namespace stencil{
 		
 		#undef FOR_DIMENSION
 
+		// read-only fields, the index of the field instead of the time step
+		#define FOR_DIMENSION(N) \
+			template<typename E, size_t D, unsigned C>\
+			inline typename std::enable_if< is_eq<D, N>::value, const E&>::type
+
+		FOR_DIMENSION(1) getAux(const BufferSet<E,D,C>& b, unsigned i, unsigned field){
+			assert(i<b.dimension_sizes[0] && "i out of range");
+			assert(field<b.auxiliaries && "no such field");
+			return b.storage[b.buffer_size*(b.copies + field) + i];
+		}
+
+		FOR_DIMENSION(2) getAux(const BufferSet<E,D,C>& b, unsigned i, unsigned j, unsigned field){
+			assert(i<b.dimension_sizes[0] && "i out of range");
+			assert(j<b.dimension_sizes[1] && "j out of range");
+			assert(field<b.auxiliaries && "no such field");
+			return b.storage[b.buffer_size*(b.copies + field) + i+(j*b.dimension_sizes[0])];
+		}
+
+		FOR_DIMENSION(3) getAux(const BufferSet<E,D,C>& b, unsigned i, unsigned j, unsigned k, unsigned field){
+			assert(i<b.dimension_sizes[0] && "i out of range");
+			assert(j<b.dimension_sizes[1] && "j out of range");
+			assert(k<b.dimension_sizes[2] && "k out of range");
+			assert(field<b.auxiliaries && "no such field");
+			return b.storage[b.buffer_size*(b.copies + field) + i+(j*b.dimension_sizes[0])+(k*b.dimension_sizes[1]*b.dimension_sizes[0])];
+		}
+
+		FOR_DIMENSION(4) getAux(const BufferSet<E,D,C>& b, unsigned i, unsigned j, unsigned k, unsigned w, unsigned field){
+			assert(i<b.dimension_sizes[0] && "i out of range");
+			assert(j<b.dimension_sizes[1] && "j out of range");
+			assert(k<b.dimension_sizes[2] && "k out of range");
+			assert(field<b.auxiliaries && "no such field");
+			return b.storage[b.buffer_size*(b.copies + field) + i+(j*b.dimension_sizes[0])+(k*b.dimension_sizes[1]*b.dimension_sizes[0]) + 
+										(w*b.dimension_sizes[2]*b.dimension_sizes[1]*b.dimension_sizes[0])];
+		}
+
+		#undef FOR_DIMENSION
+
+		// read-only fields of a storage, those without attach have none
+		template <typename DataStorage>
+		inline unsigned getAuxiliaries(const DataStorage&){
+			return 0;
+		}
+
+		template<typename E, size_t D, unsigned C>
+		inline unsigned getAuxiliaries(const BufferSet<E,D,C>& b){
+			return b.auxiliaries;
+		}
+
 
 		#define FROM_DIMENSION(N) \
 			template<typename E, size_t D, unsigned C>\
@@ -213,10 +312,13 @@ namespace stencil{
 		size_t buffer_size;
 		PairType* storage;
 
+		// time step of the current state, first for even steps, second for odd ones
+		unsigned time;
+
 // ~~~~~~~~~~~~~~~~~~~~~~~ Canonical  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 		BufferSet2(const std::array<size_t, Dimensions>& dimension_sizes, const std::vector<Elem>& data)
-			: dimension_sizes(dimension_sizes) 
+			: dimension_sizes(dimension_sizes), time(0)
 		{ 
 			buffer_size = 1;
 			for (auto i = 0; i < Dimensions; ++i)  buffer_size *= dimension_sizes[i];
@@ -228,7 +330,7 @@ namespace stencil{
 		}
 
 		BufferSet2(const std::array<size_t, Dimensions>& dimension_sizes, const Elem* data)
-			: dimension_sizes(dimension_sizes) 
+			: dimension_sizes(dimension_sizes), time(0)
 		{ 
 			buffer_size = 1;
 			for (auto i = 0; i < Dimensions; ++i)  buffer_size *= dimension_sizes[i];
@@ -244,7 +346,7 @@ namespace stencil{
 		BufferSet2(const BufferSet2<Elem, Dimensions>& o) = delete;
 		
 		BufferSet2(BufferSet2<Elem, Dimensions>&& o)
-		: dimension_sizes(o.dimension_sizes), buffer_size(o.buffer_size), storage(nullptr)
+		: dimension_sizes(o.dimension_sizes), buffer_size(o.buffer_size), storage(nullptr), time(o.time)
 		{ 
 			o.buffer_size = 0;
 			std::swap(storage, o.storage);
@@ -260,6 +362,24 @@ namespace stencil{
 			return buffer_size;
 		}
 
+		unsigned getTime() const{
+			return time;
+		}
+
+		void setTime(unsigned t){
+			time = t;
+		}
+
+		unsigned getCurrentCopy() const{
+			return time % 2;
+		}
+
+		// first value of the current state, the copies are interleaved: points are 2 elements apart
+		Elem* getCurrentPointer(){
+			static_assert(sizeof(PairType) == 2*sizeof(Elem), "pairs are expected without padding");
+			return getCurrentCopy()? &storage[0].second: &storage[0].first;
+		}
+
 		Hyperspace<dimensions> getGlobalHyperspace(){
 
 			std::array<int, dimensions> a;
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cmath>
+
+#include "new_rec_stencil.h"
+#include "reduction.h"
+
+
+namespace stencil{
+
+	/**
+	 * Parameters for running a stencil until convergence.
+	 * The run is cut in epochs, each epoch is a regular recursive traversal of epoch steps
+	 * (so temporal blocking is kept inside), the residual of the last step of the epoch is
+	 * fused in the traversal and decides whether to stop.
+	 */
+	struct ConvergenceParams{
+
+		double tolerance;
+		unsigned epoch;			// length of the first epoch
+		unsigned min_epoch;		// adaptation bounds, short epochs lose temporal locality
+		unsigned max_epoch;
+		unsigned max_steps;		// give up after this many steps
+
+		ConvergenceParams(double tolerance, unsigned max_steps = 1<<20)
+		: tolerance(tolerance), epoch(32), min_epoch(8), max_epoch(1024), max_steps(max_steps)
+		{ }
+	};
+
+	struct ConvergenceResult{
+		unsigned steps;		// steps run, the state is in the current copy of the buffer
+		unsigned epochs;
+		double residual;	// residual of the last step
+		bool converged;
+	};
+
+namespace detail {
+
+	/**
+	 * decides the length of the next epoch: extrapolate the per step decay of the residual to
+	 * guess how many steps are missing, if it does not decay just grow the epoch
+	 */
+	inline unsigned next_epoch(const ConvergenceParams& params, unsigned current, double previous, double residual){
+
+		unsigned next = current*2;
+
+		if (previous > 0 && residual > 0 && residual < previous){
+			// a decay close to 1 rounds the rate to 1, and the guess to infinity
+			const double rate = std::pow(residual/previous, 1.0/current);
+			const double missing = std::log(params.tolerance/residual) / std::log(rate);
+			if (rate < 1 && std::isfinite(missing) && missing > 0){
+				next = (unsigned) MIN(std::ceil(missing), (double)params.max_epoch);
+			}
+		}
+
+		return MIN(MAX(next, params.min_epoch), params.max_epoch);
+	}
+
+} // detail
+
+	/**
+	 * Runs the stencil until the residual of a step is under the tolerance, or max_steps is reached.
+	 * It continues from the current time of the buffer.
+	 * The residual is any reduction whose value converts to double, the default is the
+	 * largest change of a point within one step.
+	 */
+	template <typename DataStorage, typename Kernel, typename Residual = example_reductions::MaxChange_r<>>
+	ConvergenceResult recursive_stencil_converge(DataStorage& data, const ConvergenceParams& params){
+
+		assert(params.min_epoch > 0 && params.min_epoch <= params.max_epoch);
+
+		ConvergenceResult res = {0, 0, 0.0, false};
+		unsigned epoch = MIN(MAX(params.epoch, params.min_epoch), params.max_epoch);
+		double previous = -1;
+		const unsigned start = data.getTime();
+
+		while (res.steps < params.max_steps){
+
+			const unsigned t0 = start + res.steps;
+			const unsigned t1 = start + MIN(res.steps + epoch, params.max_steps);
+
+			// only the last step of the epoch is reduced
+			auto values = detail::recursive_stencil_reduce_range<DataStorage, Kernel, Residual>(data, t0, t1, t1-1);
+			assert(values.size() == 1);
+
+			res.residual = values[0];
+			res.steps = t1 - start;
+			res.epochs++;
+
+			if (res.residual <= params.tolerance) {
+				res.converged = true;
+				break;
+			}
+
+			const unsigned done = t1 - t0;
+			epoch = detail::next_epoch(params, done, previous, res.residual);
+			previous = res.residual;
+		}
+
+		return res;
+	}
+
+} // stencil namespace
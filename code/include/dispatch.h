@@ -21,8 +21,12 @@
 # endif
 #endif
 
+#if defined(PROFILE_PARALLELISM) && (defined(CILK) || defined(_OPENMP) || defined(CXX_ASYNC) || defined(INSIEME_RT) || defined(SEQUENTIAL))
+#	error the parallelism profile runs serially, it can not be combined with other backends
+#endif
+
 
-#if !defined(_OPENMP) && ! defined(CILK) && !defined(CXX_ASYNC) && !defined(INSIEME_RT)
+#if !defined(_OPENMP) && ! defined(CILK) && !defined(CXX_ASYNC) && !defined(INSIEME_RT) && !defined(PROFILE_PARALLELISM)
 # define SEQUENTIAL 1
 #else
 // common to all parallel versions
@@ -31,11 +35,18 @@
 #endif
 
 
+#include "schedule.h"
+
+// every backend defines set_threads(n): the number of threads for the parallel regions
+// to come, it returns the number the backend will really use
+
 // macro tools, boilerplate
 #define CONCATENATE_DETAIL(x, y) x##y
 #define CONCATENATE(x, y) CONCATENATE_DETAIL(x, y)
 #define MAKE_UNIQUE(x) CONCATENATE(x, __LINE__ )
 
+#include "tools/instrument.h"
+
 
 
 // ~~~~~~~~~~~~~~~~~~~~~ SEQUENTIAL ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -43,6 +54,7 @@
 
 	namespace {
 		const static auto MAX_THREADS = 1;
+		inline unsigned set_threads(unsigned) { return 1; }
 	}
 
 	#define PARALLEL_CTX(STMT) \
@@ -50,19 +62,61 @@
 
     #define SPAWN(taskName, f, ...) \
         f(__VA_ARGS__);  \
-		int taskName;
+		int taskName; (void) taskName;
 
 	#define SYNC(...) \
 		{}
 
-	#define P_FOR(it, B, E, S, STMT) \
-		for (auto it = B; it < E; it += S) STMT
+	#define P_FOR_SCHED(it, B, E, S, SCHED, CHUNK, ...) \
+		for (auto it = B; it < E; it += S) __VA_ARGS__
 
 	// dummy promise for future values
 	typedef int PROMISE;
 
 #endif
 
+// ~~~~~~~~~~~~~~~~~~~~~ PARALLELISM PROFILE ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// serial execution measuring work and span, see tools/parallelism.h
+#ifdef PROFILE_PARALLELISM
+
+	#include "tools/parallelism.h"
+
+	namespace {
+		const static auto MAX_THREADS = 1;
+		inline unsigned set_threads(unsigned) { return 1; }
+	}
+
+	#define PARALLEL_CTX(STMT) \
+		{ \
+			stencil::profile::RegionScope MAKE_UNIQUE(region) (__FILE__, __LINE__); \
+			STMT; \
+		}
+
+    #define SPAWN(taskName, f, ...) \
+		{ \
+			stencil::profile::SpawnScope MAKE_UNIQUE(spawn); \
+			f(__VA_ARGS__); \
+		} \
+		int taskName; (void) taskName;
+
+	#define SYNC(...) \
+		stencil::profile::sync();
+
+	// every iteration is a parallel strand
+	#define P_FOR_SCHED(it, B, E, S, SCHED, CHUNK, ...) \
+		{ \
+			stencil::profile::RegionScope MAKE_UNIQUE(region) (__FILE__, __LINE__); \
+			for (auto it = B; it < E; it += S) { \
+				stencil::profile::SpawnScope MAKE_UNIQUE(spawn); \
+				__VA_ARGS__ \
+			} \
+			stencil::profile::sync(); \
+		}
+
+	typedef int PROMISE;
+
+#endif
+
 // ~~~~~~~~~~~~~~~~~~~~~ OPENMP ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 #ifdef _OPENMP
 
@@ -75,6 +129,12 @@
 		const static auto MAX_THREADS = omp_get_thread_limit();
 		static auto max_threads = MAX_THREADS * THREAD_CUTOFF;
 		std::atomic_long current_threads (0);
+
+		inline unsigned set_threads(unsigned n){
+			omp_set_num_threads(n);
+			max_threads = n * THREAD_CUTOFF;
+			return n;
+		}
 	}
     
 	#define PARALLEL_CTX(STMT) \
@@ -83,7 +143,7 @@
 		STMT;
 	
     #define SPAWN(taskName, f, ...) \
-        auto MAKE_UNIQUE(wrap) = [&] () { current_threads++; f(__VA_ARGS__); current_threads--; }; \
+        auto MAKE_UNIQUE(wrap) = [&] () { TASK_INSTRUMENT current_threads++; f(__VA_ARGS__); current_threads--; }; \
 		_Pragma( "omp task untied ") \
 		MAKE_UNIQUE(wrap)(); \
 		PROMISE taskName;
@@ -91,10 +151,22 @@
 	#define SYNC(...) \
 		_Pragma( "omp taskwait ")
 
-	#define P_FOR(it, B, E, S, STMT) \
-		_Pragma( " omp parallel ") \
-		_Pragma( "  omp for ") \
-		for (auto it = B; it < E; it += S)   STMT
+	namespace stencil{ namespace detail {
+		inline omp_sched_t omp_schedule(stencil::Schedule s){
+			switch (s){
+				case stencil::Schedule::Dynamic: return omp_sched_dynamic;
+				case stencil::Schedule::Guided:  return omp_sched_guided;
+				default:						 return omp_sched_static;
+			}
+		}
+	}}
+
+	#define P_FOR_SCHED(it, B, E, S, SCHED, CHUNK, ...) \
+		{ \
+			omp_set_schedule(stencil::detail::omp_schedule(SCHED), CHUNK); \
+			_Pragma( " omp parallel for schedule(runtime) ") \
+			for (auto it = B; it < E; it += S)   __VA_ARGS__ \
+		}
 
 
 #endif
@@ -116,22 +188,26 @@
 		const static auto MAX_THREADS = __cilkrts_get_nworkers();
 		static auto max_threads = MAX_THREADS * THREAD_CUTOFF;
 		std::atomic_long current_threads (0);
+
+		// the workers are fixed once the runtime started, use CILK_NWORKERS
+		inline unsigned set_threads(unsigned) { return MAX_THREADS; }
 	}
 
 	#define PARALLEL_CTX(STMT) \
 		STMT
 	
     #define SPAWN(taskName, f, ...) \
-        auto MAKE_UNIQUE(wrap) = [&] () { current_threads++; f(__VA_ARGS__); current_threads--; }; \
+        auto MAKE_UNIQUE(wrap) = [&] () { TASK_INSTRUMENT current_threads++; f(__VA_ARGS__); current_threads--; }; \
 		if(current_threads < max_threads) cilk_spawn MAKE_UNIQUE(wrap)(); \
 		else f(__VA_ARGS__); \
-		int taskName;
+		int taskName; (void) taskName;
 
 	#define SYNC(...) \
 		cilk_sync;
 
-	#define P_FOR(it, B, E, S, STMT) \
-		cilk_for (auto it = B; it < E; it += S)  STMT
+	// cilk balances the loop by stealing, the schedule is not used
+	#define P_FOR_SCHED(it, B, E, S, SCHED, CHUNK, ...) \
+		cilk_for (auto it = B; it < E; it += S)  __VA_ARGS__
 
 	// dummy promise for future values, sync is done based on threadgroup
 	typedef int PROMISE;
@@ -148,12 +224,19 @@
 
 	#include <thread>
 
+	#include "tools/thread_pool.h"
+
 	namespace {
 
 		const static auto MAX_THREADS = std::thread::hardware_concurrency();
 		static auto max_threads = MAX_THREADS * THREAD_CUTOFF;
 		std::atomic_long current_threads (0);
 
+		inline unsigned set_threads(unsigned n){
+			max_threads = n * THREAD_CUTOFF;
+			return stencil::detail::ForPool::instance().limit(n);
+		}
+
 	//	class Thread_Pool{
 
 	//		typedef std::pair<std::function<void(void)>, std::promise<void>> task_t;
@@ -267,7 +350,7 @@
 		std::future<void> my_async(std::function<void(void)> f){
 			if (current_threads < max_threads) {
 				current_threads++; 
-				auto wrap = [f]() { f(); current_threads--;};
+				auto wrap = [f]() { TASK_INSTRUMENT f(); current_threads--;};
 //				std::cout << "Async call " << current_threads << std::endl;
 				return std::async(std::launch::async, wrap);
 //				return Thread_Pool::add_task(wrap);
@@ -277,18 +360,17 @@
 				return std::async(std::launch::deferred, f);
 			}
 		}
-	
-		std::future<void> my_async(std::function<void(int)> f, int arg){
+
+		// the new thread is pinned to cpu, if any. Deferred calls run wherever the waiter is
+		std::future<void> my_async(std::function<void(void)> f, int cpu){
+			if (cpu < 0) return my_async(f);
 			if (current_threads < max_threads) {
-				current_threads++; 
-				auto wrap = [=] () { f(arg); current_threads--;};
-//				std::cout << "Async call " << current_threads << std::endl;
+				current_threads++;
+				auto wrap = [f, cpu]() { TASK_INSTRUMENT stencil::topology::pin_thread(cpu); f(); current_threads--;};
 				return std::async(std::launch::async, wrap);
-//				return Thread_Pool::add_task(wrap);
-			} 
-			else{ 
-//				std::cout << "Deferred call " << current_threads << std::endl;
-				return std::async(std::launch::deferred, f, arg);
+			}
+			else{
+				return std::async(std::launch::deferred, f);
 			}
 		}
 	}
@@ -301,6 +383,11 @@
         auto wrap = [&] () { f(__VA_ARGS__); }; \
 		std::future<void> taskName = my_async(wrap);
 
+	// home is the cpu the task should run on, -1 for anywhere
+    #define SPAWN_NEAR(taskName, home, f, ...) \
+        auto wrap = [&] () { f(__VA_ARGS__); }; \
+		std::future<void> taskName = my_async(wrap, home);
+
 namespace {
 
 
@@ -333,13 +420,11 @@ namespace {
 	#define SYNC(...) \
 		waitTasks(__VA_ARGS__);
 
-	#define P_FOR(it, B, E, S, STMT) \
+	// loops run on persistent workers, no thread nor future per iteration
+	#define P_FOR_SCHED(it, B, E, S, SCHED, CHUNK, ...) \
 		{ \
-			std::vector<std::future<void>> futures; \
-			auto wrap = [&] (int it) { STMT; }; \
-			for (auto it = B; it < E; it += S) \
-				futures.push_back(my_async(wrap, it)); \
-			for (const auto& f : futures) f.wait(); \
+			auto MAKE_UNIQUE(wrap) = [&] (int it) { __VA_ARGS__; }; \
+			stencil::detail::ForPool::instance().run(B, E, S, SCHED, CHUNK, MAKE_UNIQUE(wrap)); \
 		}
 
 	typedef std::future<void> PROMISE;
@@ -371,27 +456,47 @@ namespace {
 		const static auto MAX_THREADS = std::thread::hardware_concurrency();
 		static auto max_threads =  MAX_THREADS * THREAD_CUTOFF;
 		std::atomic_long current_threads (0);
+
+		// the workers are fixed once the runtime started, use IRT_NUM_WORKERS
+		inline unsigned set_threads(unsigned) { return MAX_THREADS; }
 	}
 
 	#define PARALLEL_CTX(STMT) \
 		STMT
 	
     #define SPAWN(taskName, f, ...) \
-        auto MAKE_UNIQUE(wrap) = [&] () { current_threads++; f(__VA_ARGS__); current_threads--;}; \
+        auto MAKE_UNIQUE(wrap) = [&] () { TASK_INSTRUMENT current_threads++; f(__VA_ARGS__); current_threads--;}; \
 		if(current_threads < max_threads) irt::parallel(1, MAKE_UNIQUE(wrap)); \
         else f(__VA_ARGS__);\
-		int taskName;
+		int taskName; (void) taskName;
 
 	#define SYNC(...) \
 		irt::merge_all()
 
-	#define P_FOR(it, B, E, S, STMT) \
-        auto MAKE_UNIQUE(wrap) = [&] (int it) { STMT; }; \
-		irt::pfor(B, E, S, MAKE_UNIQUE(wrap));
+	// the runtime decides the distribution, the schedule is not used
+	#define P_FOR_SCHED(it, B, E, S, SCHED, CHUNK, ...) \
+		{ \
+			auto MAKE_UNIQUE(wrap) = [&] (int it) { __VA_ARGS__; }; \
+			irt::pfor(B, E, S, MAKE_UNIQUE(wrap)); \
+		}
 
 	// dummy promise
 	typedef int PROMISE;
 
 #endif
 
+// ~~~~~~~~~~~~~~~~~~~~~ LOCALITY AWARE SPAWN ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// SPAWN_NEAR(task, home, f, args...) is a SPAWN with a hint of the cpu to use,
+// backends without thread placement ignore it (home is not even evaluated)
+
+#ifndef SPAWN_NEAR
+#	define SPAWN_NEAR(taskName, home, f, ...) \
+		SPAWN(taskName, f, __VA_ARGS__)
+#endif
+
+// ~~~~~~~~~~~~~~~~~~~~~ PARALLEL LOOPS ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// P_FOR_SCHED(it, begin, end, step, schedule, chunk, statement)
+// P_FOR is a static schedule with even chunks
 
+#define P_FOR(it, B, E, S, ...) \
+	P_FOR_SCHED(it, B, E, S, stencil::Schedule::Static, 0, __VA_ARGS__)
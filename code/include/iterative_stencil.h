@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+
+#include "kernel.h"
+#include "bufferSet.h"
+#include "dispatch.h"
+
+
+namespace stencil{
+
+	/**
+	 * Tuned iterative schedule, the reference to compare the temporal blocking engines with.
+	 * One sweep over the domain per time step, the domain is cut in blocks which are
+	 * distributed with P_FOR, inside a block the loops go from the outermost dimension to the
+	 * innermost (memory order) and rows along dimension 0 only check bounds near the border,
+	 * the rest is vectorized (see solve_row). Kernels with a slice member compute whole blocks
+	 */
+
+namespace detail {
+
+	#define FOR_DIMENSION(N) \
+	template <typename DataStorage, typename Kernel> \
+			inline typename std::enable_if< is_eq<Kernel::dimensions, N>::value, void>::type
+
+		// points in the box [a, b) at time t
+		FOR_DIMENSION(1) iterative_block (DataStorage& data, const Kernel& kernel, const std::array<int, 1>& a, const std::array<int, 1>& b, int t){
+			solve_row<Kernel>(kernel, data, a[0], b[0], t);
+		}
+
+		FOR_DIMENSION(2) iterative_block (DataStorage& data, const Kernel& kernel, const std::array<int, 2>& a, const std::array<int, 2>& b, int t){
+			for (int j = a[1]; j < b[1]; ++j){
+				solve_row<Kernel>(kernel, data, a[0], b[0], j, t);
+			}
+		}
+
+		FOR_DIMENSION(3) iterative_block (DataStorage& data, const Kernel& kernel, const std::array<int, 3>& a, const std::array<int, 3>& b, int t){
+			for (int k = a[2]; k < b[2]; ++k){
+				for (int j = a[1]; j < b[1]; ++j){
+					solve_row<Kernel>(kernel, data, a[0], b[0], j, k, t);
+				}
+			}
+		}
+
+		FOR_DIMENSION(4) iterative_block (DataStorage& data, const Kernel& kernel, const std::array<int, 4>& a, const std::array<int, 4>& b, int t){
+			for (int w = a[3]; w < b[3]; ++w){
+				for (int k = a[2]; k < b[2]; ++k){
+					for (int j = a[1]; j < b[1]; ++j){
+						solve_row<Kernel>(kernel, data, a[0], b[0], j, k, w, t);
+					}
+				}
+			}
+		}
+
+	#undef FOR_DIMENSION
+
+	// runs the time steps [t0, t1)
+	template <typename DataStorage, typename Kernel>
+	void iterative_range(DataStorage& data, const Kernel& kernel, int t0, int t1, const std::array<int, DataStorage::dimensions>& block){
+
+		const unsigned Dimensions = DataStorage::dimensions;
+		typedef std::array<int, DataStorage::dimensions> Coords;
+
+		Coords count;
+		int blocks = 1;
+		for (unsigned d = 0; d < Dimensions; ++d){
+			assert(block[d] > 0);
+			count[d] = (data.dimension_sizes[d] + block[d] - 1) / block[d];
+			blocks *= count[d];
+		}
+
+		for (int t = t0; t < t1; ++t){
+
+			auto sweep = [&] (int id){
+				const Kernel local = local_copy(kernel);
+				Coords a, b;
+				for (unsigned d = 0; d < Dimensions; ++d){
+					a[d] = (id % count[d]) * block[d];
+					b[d] = MIN(a[d] + block[d], (int)data.dimension_sizes[d]);
+					id /= count[d];
+				}
+				if (!solve_slice<Kernel>(local, data, a, b, t)) iterative_block<DataStorage, Kernel>(data, local, a, b, t);
+			};
+
+			P_FOR (id, 0, blocks, 1, { sweep(id); });
+		}
+
+		data.setTime(t1);
+	}
+
+} // detail
+
+	/**
+	 * Runs t time steps from copy 0, block is the size of the blocks, a block as long as
+	 * dimension 0 keeps the rows whole
+	 */
+	template <typename DataStorage, typename Kernel>
+	void iterative_stencil(DataStorage& data, const Kernel& kernel, unsigned t, const std::array<int, DataStorage::dimensions>& block){
+		detail::iterative_range<DataStorage, Kernel>(data, kernel, 0, t, block);
+	}
+
+	template <typename DataStorage, typename Kernel>
+	void iterative_stencil(DataStorage& data, unsigned t, const std::array<int, DataStorage::dimensions>& block){
+		iterative_stencil<DataStorage, Kernel>(data, stateless<Kernel>(), t, block);
+	}
+
+} // stencil namespace
@@ -2,6 +2,7 @@
 
 
 #include <array>
+#include <type_traits>
 
 #include "tools.h"
 
@@ -24,40 +25,250 @@ namespace stencil{
 	};
 
 
+	/**
+	 * Kernels are passed to the engines as instances, so they may carry runtime parameters
+	 * (a coefficient, a threshold) in fields, use const member functions to read them. 
+	 * Kernels without fields may keep static members, an instance calls them as well, and
+	 * the entry points which only take the type of the kernel construct one (see stateless).
+	 * The instance is passed by reference all the way down and everything inlines, there is
+	 * no dispatch, and changing a parameter needs no new instantiation.
+	 * The engines copy the kernel onto the stack for every base case (see local_copy), so
+	 * fields must be trivially copyable: point to tables instead of holding containers
+	 */
+
+	namespace detail{
+
+		template <typename KernelType, typename = void>
+		struct has_without_bounduaries : public std::false_type {};
+
+		template <typename KernelType>
+		struct has_without_bounduaries<KernelType, decltype((void)&KernelType::withoutBonduaries)> : public std::true_type {};
+	}
+
+	// the instance of a kernel without fields, for the entry points which take only its type
+	template <typename KernelType>
+	inline KernelType stateless(){
+		static_assert(std::is_empty<KernelType>::value, "a kernel with fields must be passed as an instance");
+		return KernelType();
+	}
+
+	// the copy of the kernel an engine keeps for a base case, stores to the data cannot change it
+	template <typename KernelType>
+	inline KernelType local_copy(const KernelType& kernel){
+		static_assert(std::is_trivially_copyable<KernelType>::value, "kernels are copied per base case, their fields must be trivially copyable");
+		return kernel;
+	}
+
 	#define FOR_DIMENSION(N) \
 	template <bool WithBonduaries, typename KernelType, typename DataStorage> \
 			inline typename std::enable_if< is_eq<KernelType::dimensions, N>::value, void>::type
 
+		FOR_DIMENSION(1)  solve (const KernelType& kernel, DataStorage& data, int x, int t){
+			static_assert(detail::has_without_bounduaries<KernelType>::value, "kernel has no version without bounduaries");
+			if (WithBonduaries) kernel.withBonduaries(data, x, t);
+			else				kernel.withoutBonduaries(data, x, t);
+		}
+
+		FOR_DIMENSION(2)  solve (const KernelType& kernel, DataStorage& data, int x, int y, int t){
+			static_assert(detail::has_without_bounduaries<KernelType>::value, "kernel has no version without bounduaries");
+			if (WithBonduaries) kernel.withBonduaries(data, x, y, t);
+			else				kernel.withoutBonduaries(data, x, y ,t);
+		}
+
+		FOR_DIMENSION(3)  solve (const KernelType& kernel, DataStorage& data, int x, int y, int z, int t){
+			static_assert(detail::has_without_bounduaries<KernelType>::value, "kernel has no version without bounduaries");
+			if (WithBonduaries) kernel.withBonduaries(data, x, y, z, t);
+			else				kernel.withoutBonduaries(data, x, y, z, t);
+		}
+
+		FOR_DIMENSION(4)  solve (const KernelType& kernel, DataStorage& data, int x, int y, int z, int w, int t){
+			static_assert(detail::has_without_bounduaries<KernelType>::value, "kernel has no version without bounduaries");
+
+			if (WithBonduaries) kernel.withBonduaries(data, x, y, z, w, t);
+			else				kernel.withoutBonduaries(data, x, y, z, w, t);
+		}
+
+		// kernels without fields
+
 		FOR_DIMENSION(1)  solve (DataStorage& data, int x, int t){
-			static_assert(sizeof(KernelType) == 1, "no fields allowed in kernel type");
-			static_assert( std::is_function<decltype(KernelType::withoutBonduaries)>::value, "kernel has no version without bounduaries");
-			if (WithBonduaries) KernelType::withBonduaries(data, x, t);
-			else				KernelType::withoutBonduaries(data, x, t);
+			solve<WithBonduaries, KernelType, DataStorage>(stateless<KernelType>(), data, x, t);
 		}
 
 		FOR_DIMENSION(2)  solve (DataStorage& data, int x, int y, int t){
-			static_assert(sizeof(KernelType) == 1, "no fields allowed in kernel type");
-			static_assert( std::is_function<decltype(KernelType::withoutBonduaries)>::value, "kernel has no version without bounduaries");
-			if (WithBonduaries) KernelType::withBonduaries(data, x, y, t);
-			else				KernelType::withoutBonduaries(data, x, y ,t);
+			solve<WithBonduaries, KernelType, DataStorage>(stateless<KernelType>(), data, x, y, t);
 		}
 
 		FOR_DIMENSION(3)  solve (DataStorage& data, int x, int y, int z, int t){
-			static_assert(sizeof(KernelType) == 1, "no fields allowed in kernel type");
-			static_assert( std::is_function<decltype(KernelType::withoutBonduaries)>::value, "kernel has no version without bounduaries");
-			if (WithBonduaries) KernelType::withBonduaries(data, x, y, z, t);
-			else				KernelType::withoutBonduaries(data, x, y, z, t);
+			solve<WithBonduaries, KernelType, DataStorage>(stateless<KernelType>(), data, x, y, z, t);
 		}
 
 		FOR_DIMENSION(4)  solve (DataStorage& data, int x, int y, int z, int w, int t){
-			static_assert(sizeof(KernelType) == 1, "no fields allowed in kernel type");
-			static_assert( std::is_function<decltype(KernelType::withoutBonduaries)>::value, "kernel has no version without bounduaries");
+			solve<WithBonduaries, KernelType, DataStorage>(stateless<KernelType>(), data, x, y, z, w, t);
+		}
+
+	#undef FOR_DIMENSION
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~ rows ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	// the points of a row are independent (they read t, write t+1), tell the compiler. 
+	// Kernels used by rows must not carry state from one point to the next
+#if defined(_OPENMP)
+#	define VECTORIZE_LOOP _Pragma("omp simd")
+#elif defined(__INTEL_COMPILER)
+#	define VECTORIZE_LOOP _Pragma("ivdep")
+#elif defined(__GNUC__)
+#	define VECTORIZE_LOOP _Pragma("GCC ivdep")
+#else
+#	define VECTORIZE_LOOP
+#endif
+
+	namespace detail{
+
+		// a kernel may compute the inner part of a row at once with a member
+		// interior_row(data, ia, ib, coords..., t), see kernel_dsl.h
+		template <typename KernelType, typename DataStorage, typename ... Coords>
+		inline auto interior_row_hook(const KernelType& kernel, DataStorage& data, int ia, int ib, int, Coords ... coords)
+						-> decltype(kernel.interior_row(data, ia, ib, coords...), void()){
+			kernel.interior_row(data, ia, ib, coords...);
+		}
+
+		template <typename KernelType, typename DataStorage, typename ... Coords>
+		inline void interior_row_hook(const KernelType& kernel, DataStorage& data, int ia, int ib, long, Coords ... coords){
+			VECTORIZE_LOOP
+			for (int i = ia; i < ib; ++i) solve<false, KernelType, DataStorage>(kernel, data, i, coords...);
+		}
+
+		// solves [ia, ib) of a row along dimension 0, only the ends closer than neighbours to 
+		// the border are checked, unless the row itself is close to the border (inner false)
+		template <typename KernelType, typename DataStorage, typename ... Coords>
+		inline void solve_row_split(const KernelType& kernel, DataStorage& data, int ia, int ib, bool inner, Coords ... coords){
+
+			if (!inner){
+				for (int i = ia; i < ib; ++i) solve<true, KernelType, DataStorage>(kernel, data, i, coords...);
+				return;
+			}
 
-			if (WithBonduaries) KernelType::withBonduaries(data, x, y, z, w, t);
-			else				KernelType::withoutBonduaries(data, x, y, z, w, t);
+			const int n = KernelType::neighbours;
+			const int ea = MIN(MAX(ia, n), ib);
+			const int eb = MAX(MIN(ib, (int)data.dimension_sizes[0] - n), ea);
+
+			for (int i = ia; i < ea; ++i) solve<true,  KernelType, DataStorage>(kernel, data, i, coords...);
+			interior_row_hook<KernelType>(kernel, data, ea, eb, 0, coords...);
+			for (int i = eb; i < ib; ++i) solve<true,  KernelType, DataStorage>(kernel, data, i, coords...);
+		}
+
+		template <typename KernelType, typename DataStorage>
+		inline bool inner_coord(const DataStorage& data, unsigned dim, int x){
+			return x >= (int)KernelType::neighbours && x < (int)data.dimension_sizes[dim] - (int)KernelType::neighbours;
+		}
+	}
+
+	#define FOR_DIMENSION(N) \
+	template <typename KernelType, typename DataStorage> \
+			inline typename std::enable_if< is_eq<KernelType::dimensions, N>::value, void>::type
+
+		/**
+		 * Computes the points [ia, ib) of one row along dimension 0 at time t, using the
+		 * version without bounduaries wherever the whole neighbourhood is inside the domain
+		 */
+		FOR_DIMENSION(1)  solve_row (const KernelType& kernel, DataStorage& data, int ia, int ib, int t){
+			detail::solve_row_split<KernelType>(kernel, data, ia, ib, true, t);
+		}
+
+		FOR_DIMENSION(2)  solve_row (const KernelType& kernel, DataStorage& data, int ia, int ib, int y, int t){
+			const bool inner = detail::inner_coord<KernelType>(data, 1, y);
+			detail::solve_row_split<KernelType>(kernel, data, ia, ib, inner, y, t);
+		}
+
+		FOR_DIMENSION(3)  solve_row (const KernelType& kernel, DataStorage& data, int ia, int ib, int y, int z, int t){
+			const bool inner = detail::inner_coord<KernelType>(data, 1, y) && detail::inner_coord<KernelType>(data, 2, z);
+			detail::solve_row_split<KernelType>(kernel, data, ia, ib, inner, y, z, t);
+		}
+
+		FOR_DIMENSION(4)  solve_row (const KernelType& kernel, DataStorage& data, int ia, int ib, int y, int z, int w, int t){
+			const bool inner = detail::inner_coord<KernelType>(data, 1, y) && detail::inner_coord<KernelType>(data, 2, z) &&
+							   detail::inner_coord<KernelType>(data, 3, w);
+			detail::solve_row_split<KernelType>(kernel, data, ia, ib, inner, y, z, w, t);
+		}
+
+		// kernels without fields
+
+		FOR_DIMENSION(1)  solve_row (DataStorage& data, int ia, int ib, int t){
+			solve_row<KernelType>(stateless<KernelType>(), data, ia, ib, t);
+		}
+
+		FOR_DIMENSION(2)  solve_row (DataStorage& data, int ia, int ib, int y, int t){
+			solve_row<KernelType>(stateless<KernelType>(), data, ia, ib, y, t);
+		}
+
+		FOR_DIMENSION(3)  solve_row (DataStorage& data, int ia, int ib, int y, int z, int t){
+			solve_row<KernelType>(stateless<KernelType>(), data, ia, ib, y, z, t);
+		}
+
+		FOR_DIMENSION(4)  solve_row (DataStorage& data, int ia, int ib, int y, int z, int w, int t){
+			solve_row<KernelType>(stateless<KernelType>(), data, ia, ib, y, z, w, t);
 		}
 
 	#undef FOR_DIMENSION
 
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~ optional kernel hooks ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	namespace detail{
+
+		template <typename KernelType, size_t Dimensions>
+		inline auto slice_done_hook(const KernelType& kernel, int t, const std::array<int, Dimensions>& corner, int) 
+						-> decltype(kernel.slice_done(t, corner), void()){
+			kernel.slice_done(t, corner);
+		}
+
+		template <typename KernelType, size_t Dimensions>
+		inline void slice_done_hook(const KernelType&, int, const std::array<int, Dimensions>&, long){
+		}
+
+		template <typename KernelType, typename DataStorage, size_t Dimensions>
+		inline auto slice_hook(const KernelType& kernel, DataStorage& data, const std::array<int, Dimensions>& a, const std::array<int, Dimensions>& b, int t, int)
+						-> decltype(kernel.slice(data, a, b, t), bool()){
+			kernel.slice(data, a, b, t);
+			return true;
+		}
+
+		template <typename KernelType, typename DataStorage, size_t Dimensions>
+		inline bool slice_hook(const KernelType&, DataStorage&, const std::array<int, Dimensions>&, const std::array<int, Dimensions>&, int, long){
+			return false;
+		}
+	}
+
+	/**
+	 * A kernel may compute a whole slice, the box [a, b) at time t, with a 
+	 * slice(data, a, b, t) member, e.g. one pass per dimension of a separable filter.
+	 * The base case (one time step of a zoid) and the iterative blocks use it instead of 
+	 * their loops, it must check the bounduaries itself. Returns false if the kernel has none
+	 */
+	template <typename KernelType, typename DataStorage, size_t Dimensions>
+	inline bool solve_slice(const KernelType& kernel, DataStorage& data, const std::array<int, Dimensions>& a, const std::array<int, Dimensions>& b, int t){
+		return detail::slice_hook<KernelType>(kernel, data, a, b, t, 0);
+	}
+
+	template <typename KernelType, typename DataStorage, size_t Dimensions>
+	inline bool solve_slice(DataStorage& data, const std::array<int, Dimensions>& a, const std::array<int, Dimensions>& b, int t){
+		return solve_slice<KernelType>(stateless<KernelType>(), data, a, b, t);
+	}
+
+	/**
+	 * A kernel may provide a slice_done(t, corner) member, the base case calls it 
+	 * every time it finishes one time step of a zoid. The corner is the lowest point of the
+	 * slice, no two non empty slices of the same time step share it.
+	 * Kernels without it pay nothing.
+	 */
+	template <typename KernelType, size_t Dimensions>
+	inline void slice_done(const KernelType& kernel, int t, const std::array<int, Dimensions>& corner){
+		detail::slice_done_hook<KernelType>(kernel, t, corner, 0);
+	}
+
+	template <typename KernelType, size_t Dimensions>
+	inline void slice_done(int t, const std::array<int, Dimensions>& corner){
+		slice_done<KernelType>(stateless<KernelType>(), t, corner);
+	}
+
 
 } // stencil namespace
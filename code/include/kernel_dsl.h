@@ -0,0 +1,324 @@
+#pragma once
+
+#include <array>
+#include <type_traits>
+
+#include "kernel.h"
+#include "bufferSet.h"
+
+
+namespace stencil{
+namespace dsl{
+
+	/**
+	 * Kernels described by their shape instead of written by hand.
+	 * A description is a type with
+	 *   - shape: the offsets the kernel reads, Offsets<Offset<...>, ...> or Box<Dimensions, Reach>
+	 *   - apply(n): the new value of a point, n[k] is the value at offset k of the shape at time t
+	 * Stencil<DataStorage, Description> derives everything else: neighbours (the slopes of the
+	 * recursion and the halos of the tiled engines) is the reach of the shape, the version with
+	 * bounduaries reads outer points as zero (n.inside(k) tells them apart), the version without
+	 * them reads straight from memory, and whole rows are computed with one pointer per offset
+	 * so the compiler can vectorize them (see solve_row).
+	 * Descriptions may declare flops per point, a weighted sum is 2 per offset by default.
+	 * The storage must keep each copy contiguous, as BufferSet does.
+	 */
+
+	// one offset per dimension, dimension 0 first
+	template <int ... D>
+	struct Offset{
+		static const unsigned dimensions = sizeof...(D);
+
+		static std::array<int, sizeof...(D)> coords(){
+			return std::array<int, sizeof...(D)>{{ D... }};
+		}
+	};
+
+namespace detail {
+
+	template <int ... V>
+	struct max_abs{
+		static const int value = 0;
+	};
+
+	template <int H, int ... T>
+	struct max_abs<H, T...>{
+		static const int head = H < 0? -H: H;
+		static const int value = head > max_abs<T...>::value? head: max_abs<T...>::value;
+	};
+
+	template <typename O>
+	struct reach_of;
+
+	template <int ... D>
+	struct reach_of<Offset<D...>>{
+		static const int value = max_abs<D...>::value;
+	};
+
+	template <typename ... O>
+	struct max_reach{
+		static const int value = 0;
+	};
+
+	template <typename H, typename ... T>
+	struct max_reach<H, T...>{
+		static const int value = reach_of<H>::value > max_reach<T...>::value? reach_of<H>::value: max_reach<T...>::value;
+	};
+
+	template <unsigned Dimensions, typename ... O>
+	struct same_dimensions{
+		static const bool value = true;
+	};
+
+	template <unsigned Dimensions, typename H, typename ... T>
+	struct same_dimensions<Dimensions, H, T...>{
+		static const bool value = H::dimensions == Dimensions && same_dimensions<Dimensions, T...>::value;
+	};
+
+	template <typename O, typename ... T>
+	struct first{
+		typedef O type;
+	};
+
+} // detail
+
+	// explicit list of offsets
+	template <typename ... O>
+	struct Offsets{
+		static_assert(sizeof...(O) > 0, "a stencil reads at least one point");
+
+		static const unsigned dimensions = detail::first<O...>::type::dimensions;
+		static const unsigned count = sizeof...(O);
+		static const unsigned reach = detail::max_reach<O...>::value;
+
+		static_assert(detail::same_dimensions<dimensions, O...>::value, "all offsets must have the same dimensions");
+
+		static int offset(unsigned k, unsigned d){
+			const std::array<int, dimensions> values[] = { O::coords()... };
+			return values[k][d];
+		}
+	};
+
+	// the (2 Reach + 1)^Dimensions box, the last dimension runs fastest:
+	// for 2D, k = (dx + Reach) * (2 Reach + 1) + (dy + Reach)
+	template <unsigned Dimensions, unsigned Reach>
+	struct Box{
+		static const unsigned dimensions = Dimensions;
+		static const unsigned side = 2*Reach+1;
+		static const unsigned reach = Reach;
+		static const unsigned count = Dimensions == 1? side: Dimensions == 2? side*side: Dimensions == 3? side*side*side: side*side*side*side;
+
+		static int offset(unsigned k, unsigned d){
+			for (unsigned e = d+1; e < Dimensions; ++e) k /= side;
+			return (int)(k % side) - (int)Reach;
+		}
+	};
+
+namespace detail {
+
+	template <typename Description, typename = void>
+	struct flops_of{
+		static const unsigned value = 2 * Description::shape::count;
+	};
+
+	template <typename Description>
+	struct flops_of<Description, typename std::enable_if<sizeof(Description::flops) != 0>::type>{
+		static const unsigned value = Description::flops;
+	};
+
+	// distance in elements from a point to each offset
+	template <typename Shape, typename DataStorage>
+	inline void deltas(const DataStorage& data, long* res){
+		for (unsigned k = 0; k < Shape::count; ++k){
+			long stride = 1;
+			res[k] = 0;
+			for (unsigned d = 0; d < Shape::dimensions; ++d){
+				res[k] += Shape::offset(k, d) * stride;
+				stride *= data.dimension_sizes[d];
+			}
+		}
+	}
+
+	template <typename DataStorage>
+	inline typename DataStorage::ElementType* copy_at(DataStorage& data, int t){
+		return data.getPointer(t % DataStorage::copies);
+	}
+
+	template <typename DataStorage, size_t Dimensions>
+	inline long linear(const DataStorage& data, const std::array<int, Dimensions>& p){
+		long res = 0, stride = 1;
+		for (unsigned d = 0; d < Dimensions; ++d){
+			res += p[d] * stride;
+			stride *= data.dimension_sizes[d];
+		}
+		return res;
+	}
+
+	// the neighbourhood as seen by apply
+
+	template <typename Shape, typename Elem>
+	struct Unchecked{
+		typedef Elem value_type;
+		static const unsigned count = Shape::count;
+
+		const Elem* center;
+		const long* delta;
+
+		Elem operator[] (unsigned k) const { return center[delta[k]]; }
+		bool inside(unsigned) const { return true; }
+	};
+
+	template <typename Shape, typename Elem>
+	struct Bounded{
+		typedef Elem value_type;
+		static const unsigned count = Shape::count;
+
+		const Elem* center;
+		const long* delta;
+		bool in[Shape::count];
+
+		Elem operator[] (unsigned k) const { return in[k]? center[delta[k]]: Elem(); }
+		bool inside(unsigned k) const { return in[k]; }
+	};
+
+	template <typename Description, typename DataStorage, size_t Dimensions>
+	inline void point(DataStorage& data, const std::array<int, Dimensions>& p, int t, bool bounded){
+
+		typedef typename Description::shape Shape;
+		typedef typename DataStorage::ElementType Elem;
+
+		long delta[Shape::count];
+		deltas<Shape>(data, delta);
+		const long at = linear(data, p);
+		const Elem* center = copy_at(data, t) + at;
+
+		if (!bounded){
+			const Unchecked<Shape, Elem> n = { center, delta };
+			copy_at(data, t+1)[at] = Description::apply(n);
+			return;
+		}
+
+		Bounded<Shape, Elem> n;
+		n.center = center;
+		n.delta = delta;
+		for (unsigned k = 0; k < Shape::count; ++k){
+			n.in[k] = true;
+			for (unsigned d = 0; d < Dimensions; ++d){
+				const int x = p[d] + Shape::offset(k, d);
+				n.in[k] = n.in[k] && x >= 0 && x < (int)data.dimension_sizes[d];
+			}
+		}
+		copy_at(data, t+1)[at] = Description::apply(n);
+	}
+
+	// [ia, ib) of the row starting at p, every offset inside the domain
+	template <typename Description, typename DataStorage, size_t Dimensions>
+	inline void row(DataStorage& data, int ia, int ib, std::array<int, Dimensions> p, int t){
+
+		typedef typename Description::shape Shape;
+		typedef typename DataStorage::ElementType Elem;
+
+		long delta[Shape::count];
+		deltas<Shape>(data, delta);
+		p[0] = 0;
+		const long at = linear(data, p);
+		const Elem* in = copy_at(data, t) + at;
+		Elem* out = copy_at(data, t+1) + at;
+
+		VECTORIZE_LOOP
+		for (int i = ia; i < ib; ++i){
+			const Unchecked<Shape, Elem> n = { in + i, delta };
+			out[i] = Description::apply(n);
+		}
+	}
+
+} // detail
+
+	template <typename DataStorage, typename Description, unsigned Dimensions = Description::shape::dimensions>
+	struct Stencil;
+
+	#define STENCIL_BODY(D) \
+		static_assert(DataStorage::dimensions == D, "the shape and the storage have different dimensions"); \
+		static const unsigned int neighbours = Description::shape::reach; \
+		static const unsigned int flops = detail::flops_of<Description>::value;
+
+	template <typename DataStorage, typename Description>
+	struct Stencil<DataStorage, Description, 1> : public Kernel<DataStorage, 1, Stencil<DataStorage, Description, 1>>{
+		STENCIL_BODY(1)
+
+		static void withBonduaries (DataStorage& data, int i, int t){
+			detail::point<Description>(data, std::array<int, 1>{{i}}, t, true);
+		}
+		static void withoutBonduaries (DataStorage& data, int i, int t){
+			detail::point<Description>(data, std::array<int, 1>{{i}}, t, false);
+		}
+		static void interior_row (DataStorage& data, int ia, int ib, int t){
+			detail::row<Description>(data, ia, ib, std::array<int, 1>{{0}}, t);
+		}
+	};
+
+	template <typename DataStorage, typename Description>
+	struct Stencil<DataStorage, Description, 2> : public Kernel<DataStorage, 2, Stencil<DataStorage, Description, 2>>{
+		STENCIL_BODY(2)
+
+		static void withBonduaries (DataStorage& data, int i, int j, int t){
+			detail::point<Description>(data, std::array<int, 2>{{i, j}}, t, true);
+		}
+		static void withoutBonduaries (DataStorage& data, int i, int j, int t){
+			detail::point<Description>(data, std::array<int, 2>{{i, j}}, t, false);
+		}
+		static void interior_row (DataStorage& data, int ia, int ib, int j, int t){
+			detail::row<Description>(data, ia, ib, std::array<int, 2>{{0, j}}, t);
+		}
+	};
+
+	template <typename DataStorage, typename Description>
+	struct Stencil<DataStorage, Description, 3> : public Kernel<DataStorage, 3, Stencil<DataStorage, Description, 3>>{
+		STENCIL_BODY(3)
+
+		static void withBonduaries (DataStorage& data, int i, int j, int k, int t){
+			detail::point<Description>(data, std::array<int, 3>{{i, j, k}}, t, true);
+		}
+		static void withoutBonduaries (DataStorage& data, int i, int j, int k, int t){
+			detail::point<Description>(data, std::array<int, 3>{{i, j, k}}, t, false);
+		}
+		static void interior_row (DataStorage& data, int ia, int ib, int j, int k, int t){
+			detail::row<Description>(data, ia, ib, std::array<int, 3>{{0, j, k}}, t);
+		}
+	};
+
+	template <typename DataStorage, typename Description>
+	struct Stencil<DataStorage, Description, 4> : public Kernel<DataStorage, 4, Stencil<DataStorage, Description, 4>>{
+		STENCIL_BODY(4)
+
+		static void withBonduaries (DataStorage& data, int i, int j, int k, int w, int t){
+			detail::point<Description>(data, std::array<int, 4>{{i, j, k, w}}, t, true);
+		}
+		static void withoutBonduaries (DataStorage& data, int i, int j, int k, int w, int t){
+			detail::point<Description>(data, std::array<int, 4>{{i, j, k, w}}, t, false);
+		}
+		static void interior_row (DataStorage& data, int ia, int ib, int j, int k, int w, int t){
+			detail::row<Description>(data, ia, ib, std::array<int, 4>{{0, j, k, w}}, t);
+		}
+	};
+
+	#undef STENCIL_BODY
+
+	/**
+	 * weighted sum over the shape, Weights::weight(k) is the weight of offset k.
+	 * Accumulates in double
+	 */
+	template <typename Shape, typename Weights>
+	struct Linear{
+		typedef Shape shape;
+
+		template <typename Neighbourhood>
+		static double apply(const Neighbourhood& n){
+			double sum = 0.0;
+			for (unsigned k = 0; k < Shape::count; ++k) sum += n[k] * Weights::weight(k);
+			return sum;
+		}
+	};
+
+} // dsl
+} // stencil namespace
@@ -34,6 +34,7 @@ namespace example_kernels{
 			}
 
 			static const unsigned int neighbours = 1;
+			static const unsigned int flops = 3;		// two adds and a division
 		};
 
 }// example_kernels
@@ -2,8 +2,10 @@
 #pragma once
 
 #include <cmath>
+#include <vector>
 
 #include "kernel.h"
+#include "kernel_dsl.h"
 #include "bufferSet.h"
 
 
@@ -140,148 +142,206 @@ namespace example_kernels{
 
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-		template< typename DataStorage> 
-		struct Blur5_k : public Kernel<DataStorage, 2, Blur5_k<DataStorage>>{
+		/**
+		 * 5x5 gaussian blur, described with the kernel DSL (kernel_dsl.h): neighbours is the
+		 * reach of the box and the bounded, unchecked and row versions share the weights
+		 */
+		struct Blur5_weights{
+			static float weight(unsigned k){
+				static const float Kcoeff[5][5] =
+									{{0.01, 0.02, 0.04, 0.02, 0.01},
+									 {0.02, 0.04, 0.08, 0.04, 0.02},
+									 {0.04, 0.08, 0.16, 0.08, 0.04},
+									 {0.02, 0.04, 0.08, 0.04, 0.02},
+									 {0.01, 0.02, 0.04, 0.02, 0.01}};
+				return Kcoeff[k/5][k%5];
+			}
+		};
 
-			static const float Kcoeff[5][5];
+		template< typename DataStorage> 
+		struct Blur5_k : public dsl::Stencil<DataStorage, dsl::Linear<dsl::Box<2, 2>, Blur5_weights>>{
+		};
 
-			static void withBonduaries (DataStorage& data, int i, int j, int t) {
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-				//std::cout << "(" << getW(data) << "," << getH(data) << ")" << std::endl;
-				double sum = 0.0;
+		/**
+		 * Jacobi relaxation of the Laplace equation, the border values are kept (Dirichlet)
+		 */
+		template< typename DataStorage> 
+		struct Jacobi_k : public Kernel<DataStorage, 2, Jacobi_k<DataStorage>>{
 
-                for (unsigned x = MAX(0, ((int)i)-1, ((int)i)-2); x <= MIN(getW(data)-1, i+1, i+2); ++x){
-					for (unsigned y = MAX(0, ((int)j)-1, ((int)j)-2); y <= MIN(j+2, j+1, getH(data)-1); ++y){	
-						
-						int ki =  x-i+1;
-						int kj =  y-j+1;
+			static void withBonduaries (DataStorage& data, int i, int j, int t) {
 
-						auto e = getElem(data, x, y, t);
-						sum += e * Kcoeff[ki][kj];
-					}
+				if (i == 0 || i == getW(data)-1 || j == 0 || j == getH(data)-1) { 
+					getElem(data, i, j, t+1) = getElem(data, i, j, t); 
+					return;
 				}
-				
-				getElem(data, i, j, t+1) = sum;
+				withoutBonduaries(data, i, j, t);
 			}
 
 			static void withoutBonduaries (DataStorage& data, int i, int j, int t) {
 
-				//std::cout << "(" << getW(data) << "," << getH(data) << ")" << std::endl;
-				double sum = 0.0;
+				getElem(data, i, j, t+1) = ( getElem(data, i-1, j, t) +
+											 getElem(data, i+1, j, t) +
+											 getElem(data, i, j-1, t) +
+											 getElem(data, i, j+1, t) ) * 0.25;
+			}
 
-				for (unsigned x = i-2; x <= i+2; ++x){
-					for (unsigned y = j-2; y <= j+2; ++y){	
-						
-						int ki =  x-i+1;
-						int kj =  y-j+1;
+			static const unsigned int neighbours = 1;
+		};
 
-						auto e = getElem(data, x, y, t);
-						sum += e * Kcoeff[ki][kj];
-					}
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+
+		namespace detail_gaussian{
+
+			// constexpr exp for the coefficients, C++11 constexpr is one return statement:
+			// Taylor series on [-1, 1], halving the argument and squaring outside of it
+			constexpr double exp_series(double x, double term, unsigned n){
+				return n > 24? term: term + exp_series(x, term * x / n, n+1);
+			}
+
+			constexpr double square(double x){
+				return x * x;
+			}
+
+			constexpr double cexp(double x){
+				return x < -1 || x > 1? square(cexp(x / 2)): exp_series(x, 1.0, 1);
+			}
+
+			constexpr double gaussian(int d, double sigma){
+				return cexp(-(d*d) / (2 * sigma * sigma));
+			}
+
+			// sum of the taps from -r to r
+			constexpr double gaussian_sum(int r, double sigma){
+				return r == 0? gaussian(0, sigma): 2 * gaussian(r, sigma) + gaussian_sum(r-1, sigma);
+			}
+
+			template <unsigned ... I>
+			struct indices{};
+
+			template <unsigned N, unsigned ... I>
+			struct make_indices : public make_indices<N-1, N-1, I...>{};
+
+			template <unsigned ... I>
+			struct make_indices<0, I...>{
+				typedef indices<I...> type;
+			};
+		}
+
+		/**
+		 * normalized 1D gaussian of Size taps, computed at compile time. sigma is the one
+		 * OpenCV derives from the size: 0.3 ((Size-1)/2 - 1) + 0.8
+		 */
+		template <unsigned Size, typename = typename detail_gaussian::make_indices<Size>::type>
+		struct Gaussian;
+
+		template <unsigned Size, unsigned ... I>
+		struct Gaussian<Size, detail_gaussian::indices<I...>>{
+			static_assert(Size % 2 == 1, "the gaussian is centered, odd sizes only");
+
+			static constexpr double sigma = 0.3 * ((Size-1) * 0.5 - 1) + 0.8;
+			static constexpr double coefficients[Size] = 
+				{ detail_gaussian::gaussian((int)I - (int)Size/2, sigma) / detail_gaussian::gaussian_sum(Size/2, sigma)... };
+		};
+
+		template <unsigned Size, unsigned ... I>
+		constexpr double Gaussian<Size, detail_gaussian::indices<I...>>::coefficients[Size];
+
+		/**
+		 * Size x Size gaussian blur. The filter is separable, the product of two 1D gaussians:
+		 * a slice of a zoid is computed in two 1D passes, along dimension 0 into a buffer for 
+		 * the rows the second pass needs (neighbours more on each side) and then along 
+		 * dimension 1, 2 Size multiply-adds per point instead of Size^2.
+		 * The single point versions (rows of the iterative engines) add in the same order,
+		 * so all engines produce the same values. Outer points read as zero
+		 */
+		template< typename DataStorage, unsigned Size> 
+		struct BlurN_k : public Kernel<DataStorage, 2, BlurN_k<DataStorage, Size>>{
+
+			typedef Gaussian<Size> Taps;
+
+			static const unsigned int neighbours = Size/2;
+			static const unsigned int flops = 4*Size;
+
+			// weight of the offset (x, y) from the center
+			static double coefficient(int x, int y){
+				return Taps::coefficients[x+neighbours] * Taps::coefficients[y+neighbours];
+			}
+
+			// along dimension 0, of the row j
+			template <bool Bounded>
+			static double along_x (DataStorage& data, int i, int j, int t){
+				const int r = neighbours;
+				double sum = 0.0;
+				for (int x = -r; x <= r; ++x){
+					if (Bounded && (i+x < 0 || i+x >= (int)getW(data))) continue;
+					sum += getElem(data, i+x, j, t) * Taps::coefficients[x+r];
+				}
+				return sum;
+			}
+
+			template <bool Bounded>
+			static void point (DataStorage& data, int i, int j, int t){
+				const int r = neighbours;
+				double sum = 0.0;
+				for (int y = -r; y <= r; ++y){
+					if (Bounded && (j+y < 0 || j+y >= (int)getH(data))) continue;
+					sum += along_x<Bounded>(data, i, j+y, t) * Taps::coefficients[y+r];
 				}
-				
 				getElem(data, i, j, t+1) = sum;
 			}
 
-			static const unsigned int neighbours = 2;
-		};
+			static void withBonduaries (DataStorage& data, int i, int j, int t) {
+				point<true>(data, i, j, t);
+			}
 
-		template< typename DataStorage> 
-		const float Blur5_k<DataStorage>::Kcoeff[5][5] =
-									{{0.01, 0.02, 0.04, 0.02, 0.01},
-									 {0.02, 0.04, 0.08, 0.04, 0.02},
-									 {0.04, 0.08, 0.16, 0.08, 0.04},
-									 {0.02, 0.04, 0.08, 0.04, 0.02},
-									 {0.01, 0.02, 0.04, 0.02, 0.01}};
+			static void withoutBonduaries (DataStorage& data, int i, int j, int t) {
+				point<false>(data, i, j, t);
+			}
 
-// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+			static void slice (DataStorage& data, const std::array<int, 2>& a, const std::array<int, 2>& b, int t){
+				if (a[0] >= b[0] || a[1] >= b[1]) return;
+
+				const int r = neighbours;
+				const int W = getW(data);
+				const int H = getH(data);
+
+				// the first pass would compute more rows than the slice has
+				if (b[1] - a[1] <= r){
+					for (int j = a[1]; j < b[1]; ++j) solve_row<BlurN_k>(data, a[0], b[0], j, t);
+					return;
+				}
+
+				const int width = b[0] - a[0];
+				const int ja = MAX(a[1] - r, 0);
+				const int jb = MIN(b[1] + r, H);
 
+				// one buffer per thread, reused by all the slices
+				static thread_local std::vector<double> rows;
+				rows.resize(width * (jb - ja));
 
-//		/**
-//		 * a generic  gaussian blur kernel:
-//		 * http://stackoverflow.com/questions/8204645/implementing-gaussian-blur-how-to-calculate-convolution-matrix-kernel
-//		 */
-//		template< typename DataStorage, unsigned Size> 
-//		struct BlurN_k : public Kernel<DataStorage, 2, BlurN_k<DataStorage, Size>>{
-//
-//			static const unsigned int neighbours = (Size-1)>>1;
-//
-//			static float Kcoeff[Size][Size];
-//
-//			static double gaussian (double x, double mu, double sigma)  {
-//			  return exp( -(((x-mu)/(sigma))*((x-mu)/(sigma)))/2.0 );
-//			}
-//
-//			static constexpr int initialize () {
-//				assert(Size%2 == 1);
-//
-//
-//				int halfSize = Size/2;
-//			
-//				// determine sigma
-//				double sigma = Size/2.0;
-//
-//				// fill values
-//				double sum = 0;
-//				for (int row = 0; row < Size; row++){
-//					for (int col = 0; col < Size; col++) {
-//
-//						int i = row<=halfSize? row: Size-(row+1);
-//						int j = col<=halfSize? col: Size-(col+1);
-//
-//						Kcoeff[row][col] = gaussian(i, Size, sigma) * gaussian(j, Size, sigma);
-//						sum += Kcoeff[row][col];
-//					}
-//				}
-//
-//				//		  // normalize
-//				for (int row = 0; row < Size; row++){
-//					for (int col = 0; col < Size; col++){
-//						Kcoeff[row][col] /= sum;
-//					}
-//				}
-//
-//			}
-//			static const int init = initialize();
-//
-//			static void withBonduaries (DataStorage& data, unsigned i, unsigned j, unsigned t) {
-//
-//				//std::cout << "(" << getW(data) << "," << getH(data) << ")" << std::endl;
-//				double sum = 0.0;
-//
-//				assert(i < getW(data));
-//				assert(j < getH(data));
-//
-//				auto xMin = i;
-//				for (int v = 1; v <= neighbours; ++v) xMin = MAX(0, ((int)i)-v);
-//				auto xMax = i;
-//				for (int v = 1; v <= neighbours; ++v) xMax = MIN(getW(data)-1, i+v);
-//		
-//				auto yMin = j;
-//				for (int v = 1; v <= neighbours; ++v) yMin = MAX(0, ((int)j)-v);
-//				auto yMax = j;
-//				for (int v = 1; v <= neighbours; ++v) yMax = MIN(getH(data)-1, j+v);
-//
-//				for (unsigned x = xMin; x <= xMax; ++x){
-//					for (unsigned y = yMin; y <= yMax; ++y){	
-//						
-//							// this is quite not right, this offset might produce weird values 
-//							// on bonduaries, but results are uniform
-//						int ki =  x-i+neighbours;
-//						int kj =  y-j+neighbours;
-//
-//						auto e = getElem(data, x, y, t);
-//						sum += e * Kcoeff[ki][kj];
-//					}
-//				}
-//				
-//				getElem(data, i, j, t+1) = sum;
-//			}
-//
-//		};
-//
-//		template< typename DataStorage, unsigned Size> 
-//		float BlurN_k<DataStorage, Size>::Kcoeff[Size][Size];
+				const bool inner = a[0] >= r && b[0] <= W - r;
+				for (int j = ja; j < jb; ++j){
+					double* row = &rows[(j - ja) * width];
+					if (inner) for (int i = a[0]; i < b[0]; ++i) row[i - a[0]] = along_x<false>(data, i, j, t);
+					else 	   for (int i = a[0]; i < b[0]; ++i) row[i - a[0]] = along_x<true>(data, i, j, t);
+				}
+
+				for (int j = a[1]; j < b[1]; ++j){
+					const int ya = MAX(j - r, 0);
+					const int yb = MIN(j + r + 1, H);
+					for (int i = a[0]; i < b[0]; ++i){
+						double sum = 0.0;
+						for (int y = ya; y < yb; ++y){
+							sum += rows[(y - ja) * width + i - a[0]] * Taps::coefficients[y-j+r];
+						}
+						getElem(data, i, j, t+1) = sum;
+					}
+				}
+			}
+		};
 
 }// example_kernels
 }// stencil
@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include <array>
 #include <cmath>
 
 #include "kernel.h"
@@ -124,6 +125,220 @@ namespace example_kernels{
 		}
 
 		static const unsigned int neighbours = 1;
+		static const unsigned int flops = 12;		// eleven adds and a division
+	};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	namespace detail_planes{
+
+		template <typename KernelType, typename DataStorage>
+		inline bool inner(const DataStorage& data, int i, int j, int k){
+			const int r = KernelType::neighbours;
+			return i >= r && i < (int)getW(data) - r && j >= r && j < (int)getH(data) - r && k >= r && k < (int)getD(data) - r;
+		}
+
+		/**
+		 * computes the box [a, b) at time t, every point of it has its 2r+1 planes inside the domain.
+		 * Marches along k in strips along i: Kernel::plane(data, i, j, k, t) of the 2r+1 planes
+		 * around k is kept in a rolling window, one new plane per step replaces the oldest one.
+		 * Kernel::combine(data, i, j, k, t, planes, s) computes a point from the window, planes[m]
+		 * is the strip of plane k-r+m and s the position of i in the strip
+		 */
+		template <typename KernelType, typename DataStorage>
+		void march_k(DataStorage& data, const std::array<int, 3>& a, const std::array<int, 3>& b, int t){
+
+			typedef typename KernelType::Plane Plane;
+			const int r = KernelType::neighbours;
+			const int window = 2*r+1;
+			const int strip = 32;
+
+			Plane values[window][strip];
+			const Plane* planes[window];
+
+			for (int j = a[1]; j < b[1]; ++j){
+				for (int i0 = a[0]; i0 < b[0]; i0 += strip){
+					const int n = MIN(strip, b[0] - i0);
+
+					for (int k = a[2]-r; k < a[2]+r; ++k){
+						for (int s = 0; s < n; ++s) values[k % window][s] = KernelType::plane(data, i0+s, j, k, t);
+					}
+
+					for (int k = a[2]; k < b[2]; ++k){
+						Plane* next = values[(k+r) % window];
+						for (int s = 0; s < n; ++s) next[s] = KernelType::plane(data, i0+s, j, k+r, t);
+						for (int m = 0; m < window; ++m) planes[m] = values[(k-r+m) % window];
+
+						VECTORIZE_LOOP
+						for (int s = 0; s < n; ++s) getElem(data, i0+s, j, k, t+1) = KernelType::combine(data, i0+s, j, k, t, planes, s);
+					}
+				}
+			}
+		}
+
+		/**
+		 * slice hook of the kernels below: the points closer than r to the border with rows, 
+		 * the inner box with march_k. Slices thinner than the window along k are rows only,
+		 * the window would be filled for a single plane
+		 */
+		template <typename KernelType, typename DataStorage>
+		void slice(DataStorage& data, const std::array<int, 3>& a, const std::array<int, 3>& b, int t){
+
+			const int r = KernelType::neighbours;
+			std::array<int, 3> ia, ib;
+			for (unsigned d = 0; d < 3; ++d){
+				ia[d] = MIN(MAX(a[d], r), b[d]);
+				ib[d] = MAX(MIN(b[d], (int)data.dimension_sizes[d] - r), ia[d]);
+			}
+			const bool march = ib[0] > ia[0] && ib[1] > ia[1] && ib[2] - ia[2] > r;
+
+			for (int k = a[2]; k < b[2]; ++k){
+				for (int j = a[1]; j < b[1]; ++j){
+					if (!march || k < ia[2] || k >= ib[2] || j < ia[1] || j >= ib[1]){
+						solve_row<KernelType>(data, a[0], b[0], j, k, t);
+						continue;
+					}
+					for (int i = a[0]; i < ia[0]; ++i) KernelType::withBonduaries(data, i, j, k, t);
+					for (int i = ib[0]; i < b[0]; ++i) KernelType::withBonduaries(data, i, j, k, t);
+				}
+			}
+
+			if (march) march_k<KernelType>(data, ia, ib, t);
+		}
+	}
+
+	/**
+	 * Order-th order finite differences of the heat equation, the star of 6 Order/2 + 1 points:
+	 * 7 points for Order 2, 13 for 4, 19 for 6 and 25 for 8. The points closer than neighbours
+	 * to the border keep their value (Dirichlet).
+	 * There is no slice member: a star reads each value once, so a window of planes (see
+	 * march_k) would only add a store per point, plain rows are faster
+	 */
+	template< typename DataStorage, unsigned Order> 
+	struct Star_3D_k : public Kernel<DataStorage, 3, Star_3D_k<DataStorage, Order>>{
+
+		static_assert(Order == 2 || Order == 4 || Order == 6 || Order == 8, "orders 2, 4, 6 and 8");
+
+		static const unsigned int neighbours = Order/2;
+		static const unsigned int flops = 7*neighbours + 3;
+
+		// of the second derivative at distance m
+		static double coefficient(unsigned m){
+			static const double c[4][5] = {{-2.0, 1.0},
+										   {-5.0/2, 4.0/3, -1.0/12},
+										   {-49.0/18, 3.0/2, -3.0/20, 1.0/90},
+										   {-205.0/72, 8.0/5, -1.0/5, 8.0/315, -1.0/560}};
+			return c[Order/2-1][m];
+		}
+
+		// sums[m-1] is the sum of the 6 points at distance m
+		static double update(double center, const double* sums){
+			const double dt = 0.0625;		// stable up to the 8th order
+			double lap = 3 * coefficient(0) * center;
+			for (unsigned m = 1; m <= neighbours; ++m) lap += coefficient(m) * sums[m-1];
+			return center + dt * lap;
+		}
+
+		static void withBonduaries (DataStorage& data, int i, int j, int k, int t) {
+			if (!detail_planes::inner<Star_3D_k>(data, i, j, k)) { getElem(data, i, j, k, t+1) = getElem(data, i, j, k, t); return; }
+			withoutBonduaries(data, i, j, k, t);
+		}
+
+		static void withoutBonduaries (DataStorage& data, int i, int j, int k, int t) {
+			const long y = getW(data), z = y * getH(data);
+			const auto* center = &getElem(data, i, j, k, t);
+			double sums[neighbours];
+			for (long m = 1; m <= (long)neighbours; ++m){
+				sums[m-1] = (center[-m] + center[m]) + (center[-m*y] + center[m*y]) + (center[-m*z] + center[m*z]);
+			}
+			getElem(data, i, j, k, t+1) = update(*center, sums);
+		}
+
+	};
+
+	template <typename DataStorage>
+	using Star13_3D_k = Star_3D_k<DataStorage, 4>;
+
+	template <typename DataStorage>
+	using Star25_3D_k = Star_3D_k<DataStorage, 8>;
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	/**
+	 * average of the 27 point box, the border keeps its value. Slices keep the 3x3 sum of 
+	 * each plane in the window of march_k, 9 + 2 adds per point instead of 26
+	 */
+	template< typename DataStorage> 
+	struct Box_3D_k : public Kernel<DataStorage, 3, Box_3D_k<DataStorage>>{
+
+		typedef double Plane;
+
+		static const unsigned int neighbours = 1;
+		static const unsigned int flops = 27;
+
+		static void withBonduaries (DataStorage& data, int i, int j, int k, int t) {
+			if (!detail_planes::inner<Box_3D_k>(data, i, j, k)) { getElem(data, i, j, k, t+1) = getElem(data, i, j, k, t); return; }
+			withoutBonduaries(data, i, j, k, t);
+		}
+
+		static void withoutBonduaries (DataStorage& data, int i, int j, int k, int t) {
+			getElem(data, i, j, k, t+1) = ((plane(data, i, j, k-1, t) + plane(data, i, j, k, t)) + plane(data, i, j, k+1, t)) / 27.0;
+		}
+
+		// 3x3 sum around (i, j) in the plane k
+		static double plane (DataStorage& data, int i, int j, int k, int t){
+			const long w = getW(data);
+			const auto* center = &getElem(data, i, j, k, t);
+			double sum = 0.0;
+			for (long y = -w; y <= w; y += w){
+				sum += center[y-1];
+				sum += center[y];
+				sum += center[y+1];
+			}
+			return sum;
+		}
+
+		static double combine (DataStorage&, int, int, int, int, const Plane* const* planes, int s){
+			return ((planes[0][s] + planes[1][s]) + planes[2][s]) / 27.0;
+		}
+
+		static void slice (DataStorage& data, const std::array<int, 3>& a, const std::array<int, 3>& b, int t){
+			detail_planes::slice<Box_3D_k>(data, a, b, t);
+		}
+	};
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	/**
+	 * heat equation in a heterogeneous medium, the conductivity of each point is the read-only
+	 * field 0 of the storage (see BufferSet::attach). The flux through a face uses the mean
+	 * conductivity of the two points, the border keeps its value. Stable for conductivities up to 1
+	 */
+	template< typename DataStorage> 
+	struct Diffusion_3D_k : public Kernel<DataStorage, 3, Diffusion_3D_k<DataStorage>>{
+
+		static const unsigned int neighbours = 1;
+		static const unsigned int flops = 32;
+		static const unsigned int conductivity = 0;
+
+		static void withBonduaries (DataStorage& data, int i, int j, int k, int t) {
+			if (!detail_planes::inner<Diffusion_3D_k>(data, i, j, k)) { getElem(data, i, j, k, t+1) = getElem(data, i, j, k, t); return; }
+			withoutBonduaries(data, i, j, k, t);
+		}
+
+		static void withoutBonduaries (DataStorage& data, int i, int j, int k, int t) {
+			const long y = getW(data), z = y * getH(data);
+			const auto* u = &getElem(data, i, j, k, t);
+			const auto* c = &getAux(data, i, j, k, conductivity);
+			const double flux = (face(u, c, -1) + face(u, c, 1)) + (face(u, c, -y) + face(u, c, y)) + (face(u, c, -z) + face(u, c, z));
+			getElem(data, i, j, k, t+1) = *u + 0.125 * flux;
+		}
+
+		// from the neighbour at distance d in memory
+		template <typename Elem>
+		static double face (const Elem* u, const Elem* c, long d){
+			return (c[0] + c[d]) * 0.5 * (u[d] - u[0]);
+		}
 	};
 
 }// example_kernels
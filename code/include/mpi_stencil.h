@@ -0,0 +1,225 @@
+#pragma once
+
+#include <mpi.h>
+
+#include <array>
+#include <vector>
+#include <cassert>
+
+#include "bufferSet.h"
+#include "new_rec_stencil.h"
+
+
+namespace stencil{
+
+	/**
+	 * Distributed memory 3D stencil.
+	 * The domain is cut in slabs along the last dimension (k, the slowest one, so planes are
+	 * contiguous), each rank stores its slab plus halos of neighbours*K planes and runs the
+	 * recursive engine locally. After K steps the halos are exhausted, they are exchanged
+	 * and the next K steps can run: ranks talk only every K time steps, at the price of
+	 * recomputing the halo.
+	 *
+	 * The kernel sees local coordinates, the halo planes are treated as border and produce
+	 * garbage, which never reaches the owned planes within K steps. Kernels must not depend on
+	 * the absolute position in the k dimension.
+	 *
+	 * Communication is overlapped with computation: the exchange is posted non blocking, the
+	 * interior A zoid (which does not read the halos) is computed meanwhile and the two B zoids
+	 * at the sides are computed once the halos arrived.
+	 */
+	template <typename Elem, typename Kernel>
+	class MPIStencil3D{
+
+	public:
+		typedef BufferSet<Elem, 3> Buffer;
+
+	private:
+		MPI_Comm comm;
+		int rank, ranks;
+		int below, above;					// neighbour ranks, MPI_PROC_NULL at the global border
+
+		const std::array<size_t, 3> global;
+		const unsigned K;					// steps between exchanges
+		const int halo;						// planes
+
+		int first, own;						// global planes owned [first, first+own)
+		int lowHalo, highHalo;				// planes stored below and above the owned ones
+
+		Buffer local;
+
+		// the owned planes keep being written while sending, they are sent from a copy
+		std::vector<Elem> sendLow, sendHigh;
+		bool overlap;
+
+		size_t planeSize() const{
+			return global[0]*global[1];
+		}
+
+		Elem* plane(int p, unsigned copy){
+			return local.getPointer(copy) + p*planeSize();
+		}
+
+		static std::array<size_t, 3> localSizes(const std::array<size_t, 3>& global, int own, int lowHalo, int highHalo){
+			return {{ global[0], global[1], (size_t)(lowHalo + own + highHalo) }};
+		}
+
+		static int rankOf(MPI_Comm comm){ int r; MPI_Comm_rank(comm, &r); return r; }
+		static int sizeOf(MPI_Comm comm){ int s; MPI_Comm_size(comm, &s); return s; }
+
+	public:
+
+		// first plane of the slab of rank r
+		static int slab_begin(int r, int ranks, size_t depth){
+			return (depth / ranks) * r + MIN((size_t)r, depth % ranks);
+		}
+
+		/**
+		 * owned points to the planes [begin(), end()) of the initial state, every rank passes its own slab
+		 */
+		MPIStencil3D(MPI_Comm comm, const std::array<size_t, 3>& global, unsigned K, const Elem* owned)
+		: comm(comm), rank(rankOf(comm)), ranks(sizeOf(comm)),
+		  below(rank > 0? rank-1: MPI_PROC_NULL), above(rank < ranks-1? rank+1: MPI_PROC_NULL),
+		  global(global), K(K), halo(Kernel::neighbours*K),
+		  first(slab_begin(rank, ranks, global[2])), own(slab_begin(rank+1, ranks, global[2]) - first),
+		  lowHalo(below == MPI_PROC_NULL? 0: halo), highHalo(above == MPI_PROC_NULL? 0: halo),
+		  local(localSizes(global, own, lowHalo, highHalo), std::vector<Elem>(planeSize()*(lowHalo+own+highHalo))),
+		  sendLow(halo*planeSize()), sendHigh(halo*planeSize()),
+		  // the interior zoid has to be wide enough to shrink K steps from each side
+		  overlap(own >= 2*halo)
+		{
+			assert(K > 0);
+			// halos are filled from the owned planes of the next rank only
+			assert(own >= halo && "slab thinner than the halo, use less ranks or a smaller K");
+			memcpy(plane(lowHalo, 0), owned, own*planeSize()*sizeof(Elem));
+		}
+
+		int begin() const { return first; }
+		int end() const { return first + own; }
+		unsigned getTime() const { return local.getTime(); }
+		bool getOverlap() const { return overlap; }
+		void setOverlap(bool o) { overlap = o && own >= 2*halo; }
+		Buffer& getLocal() { return local; }
+
+		// owned point, global coordinates
+		Elem& at(int i, int j, int k){
+			assert(k >= begin() && k < end());
+			return getElem(local, i, j, k - first + lowHalo, local.getTime());
+		}
+
+		/**
+		 * fills the halos of the current copy with the owned planes of the neighbours
+		 */
+		void exchange(){
+
+			const unsigned copy = local.getCurrentCopy();
+			const int bytes = halo * planeSize() * sizeof(Elem);
+
+			// upwards: my top planes go to the low halo of the rank above
+			MPI_Sendrecv(plane(lowHalo + own - halo, copy), bytes, MPI_BYTE, above, 0,
+						 plane(0, copy), bytes, MPI_BYTE, below, 0, comm, MPI_STATUS_IGNORE);
+
+			// downwards
+			MPI_Sendrecv(plane(lowHalo, copy), bytes, MPI_BYTE, below, 1,
+						 plane(lowHalo + own, copy), bytes, MPI_BYTE, above, 1, comm, MPI_STATUS_IGNORE);
+		}
+
+		/**
+		 * runs steps time steps, in epochs of at most K
+		 */
+		void run(unsigned steps){
+			while (steps > 0){
+				const unsigned epoch = MIN(steps, K);
+				if (overlap) {
+					overlapped_epoch(epoch);
+				}
+				else {
+					exchange();
+					recursive_stencil_advance<Buffer, Kernel>(local, epoch);
+				}
+				steps -= epoch;
+			}
+		}
+
+	private:
+
+		void overlapped_epoch(unsigned steps){
+
+			const int t0 = local.getTime();
+			const int t1 = t0 + steps;
+			const unsigned copy = local.getCurrentCopy();
+			const int bytes = halo * planeSize() * sizeof(Elem);
+			const int n = Kernel::neighbours;
+			const int depth = lowHalo + own + highHalo;
+
+			memcpy(sendLow.data(),  plane(lowHalo, copy), bytes);
+			memcpy(sendHigh.data(), plane(lowHalo + own - halo, copy), bytes);
+
+			MPI_Request requests[4];
+			MPI_Irecv(plane(0, copy), bytes, MPI_BYTE, below, 0, comm, &requests[0]);
+			MPI_Irecv(plane(lowHalo + own, copy), bytes, MPI_BYTE, above, 1, comm, &requests[1]);
+			MPI_Isend(sendHigh.data(), bytes, MPI_BYTE, above, 0, comm, &requests[2]);
+			MPI_Isend(sendLow.data(), bytes, MPI_BYTE, below, 1, comm, &requests[3]);
+
+			// interior: shrinks by the slope wherever there is a halo, it only reads owned planes
+			const int a = lowHalo? lowHalo + n: 0;
+			const int b = highHalo? lowHalo + own - n: depth;
+			auto inner = local.getGlobalHyperspace();
+			inner.a(2) = a;  inner.da(2) = lowHalo? n: 0;
+			inner.b(2) = b;  inner.db(2) = highHalo? -n: 0;
+
+			const auto allDims = detail::all_bounds<3>();
+			const detail::Bound_flags innerLeft  = lowHalo?  allDims & ~(1<<2): allDims;
+			const detail::Bound_flags innerRight = highHalo? allDims & ~(1<<2): allDims;
+
+			PARALLEL_CTX ({
+				(detail::recursive_stencil_dispatch<Buffer, Kernel, 2>)(local, stateless<Kernel>(), inner, t0, t1, innerLeft, innerRight);
+			});
+
+			MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+
+			// sides: widen over the halos as the interior shrinks
+			PARALLEL_CTX ({
+				if (lowHalo){
+					auto side = local.getGlobalHyperspace();
+					side.b(2) = a;  side.db(2) = n;
+					(detail::recursive_stencil_B<Buffer, Kernel, 2>)(local, stateless<Kernel>(), side, t0, t1, allDims, allDims);
+				}
+				if (highHalo){
+					auto side = local.getGlobalHyperspace();
+					side.a(2) = b;  side.da(2) = -n;
+					(detail::recursive_stencil_B<Buffer, Kernel, 2>)(local, stateless<Kernel>(), side, t0, t1, allDims, allDims);
+				}
+			});
+
+			local.setTime(t1);
+		}
+
+	public:
+
+		/**
+		 * collects the current state in root, returns the whole domain there (empty elsewhere).
+		 * Counted in planes, so domains over 2GB do not overflow the int counts of MPI
+		 */
+		std::vector<Elem> gather(int root = 0){
+
+			MPI_Datatype planeType;
+			MPI_Type_contiguous(planeSize()*sizeof(Elem), MPI_BYTE, &planeType);
+			MPI_Type_commit(&planeType);
+
+			std::vector<int> counts(ranks), displs(ranks);
+			for (int r = 0; r < ranks; ++r){
+				displs[r] = slab_begin(r, ranks, global[2]);
+				counts[r] = slab_begin(r+1, ranks, global[2]) - displs[r];
+			}
+
+			std::vector<Elem> res (rank == root? planeSize()*global[2]: 0);
+			MPI_Gatherv(plane(lowHalo, local.getCurrentCopy()), own, planeType,
+						res.data(), counts.data(), displs.data(), planeType, root, comm);
+
+			MPI_Type_free(&planeType);
+			return res;
+		}
+	};
+
+} // stencil namespace
@@ -2,6 +2,7 @@
 
 
 #include <array>
+#include <vector>
 
 #include "hyperspace.h"
 #include "bufferSet.h"
@@ -9,6 +10,7 @@
 
 #include "dispatch.h"
 #include "tools/instrument.h"
+#include "tools/topology.h"
 
 #include <thread>
 #include <sstream>
@@ -25,22 +27,66 @@ namespace stencil{
 
 namespace detail {
 
+	/**
+	 * position of a zoid in [0,1): its center with the bits of the coordinates interleaved
+	 * (Z order), so neighbouring zoids get close positions. It only depends on the zoid
+	 */
+	template <typename DataStorage>
+	inline double zoid_position(const DataStorage& data, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1){
+
+		const int Dimensions = DataStorage::dimensions;
+		const int half = (t1 - t0) / 2;
+
+		std::array<double, DataStorage::dimensions> u;
+		for (int d = 0; d < Dimensions; ++d){
+			const double center = (z.a(d) + z.b(d) + (z.da(d) + z.db(d)) * half) / 2.0;
+			u[d] = MIN(MAX(center / data.dimension_sizes[d], 0.0), 0.999999);
+		}
+
+		double position = 0;
+		double weight = 0.5;
+		for (int level = 0; level < 24 / Dimensions; ++level){
+			for (int d = Dimensions-1; d >= 0; --d){
+				u[d] *= 2;
+				if (u[d] >= 1) { position += weight; u[d] -= 1; }
+				weight /= 2;
+			}
+		}
+		return position;
+	}
+
+	/**
+	 * cpu where a zoid should be computed (-1 anywhere). Neighbouring zoids, which read each
+	 * other's faces, land on cpus sharing caches, and a zoid always goes to the same place
+	 * whoever spawns it
+	 */
+	template <typename DataStorage>
+	inline int zoid_home(const DataStorage& data, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1){
+		return topology::home_cpu(zoid_position(data, z, t0, t1));
+	}
+
 	#define FOR_DIMENSION(N) \
 	template <typename DataStorage, typename KernelType, unsigned Dim, bool WithBounds=true> \
 			inline typename std::enable_if< is_eq<Dim, N>::value, void>::type
 
-		FOR_DIMENSION(1) base_case (DataStorage& data, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1){
+		FOR_DIMENSION(1) base_case (DataStorage& data, const KernelType& kernel, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1){
 
-			BC_INSTRUMENT(z)
+			BC_INSTRUMENT(z, t0, t1)
+
+			// a copy on the stack, stores to the data cannot change its fields
+			const KernelType local = local_copy(kernel);
 
 			int ia = z.a(0);
 			int ib = z.b(0);
 
 			for (int t = t0; t < t1; ++t){
 
-				for (int i = ia; i < ib; ++i){
-					solve<WithBounds, KernelType, DataStorage> (data, i, t);
+				if (!solve_slice<KernelType>(local, data, std::array<int, 1>{{ia}}, std::array<int, 1>{{ib}}, t)){
+					for (int i = ia; i < ib; ++i){
+						solve<WithBounds, KernelType, DataStorage> (local, data, i, t);
+					}
 				}
+				slice_done<KernelType> (local, t, std::array<int, 1>{{ia}});
 				ia += z.da(0);
 				ib += z.db(0);
 			}
@@ -48,9 +94,11 @@ namespace detail {
 			END_INSTUMENT;
 		}
 
-		FOR_DIMENSION(2) base_case (DataStorage& data, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1){
+		FOR_DIMENSION(2) base_case (DataStorage& data, const KernelType& kernel, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1){
 
-			BC_INSTRUMENT(z)
+			BC_INSTRUMENT(z, t0, t1)
+
+			const KernelType local = local_copy(kernel);
 
 			int ia = z.a(0);
 			int ib = z.b(0);
@@ -59,11 +107,14 @@ namespace detail {
 
 			for (int t = t0; t < t1; ++t){
 
-				for (int j = ja; j < jb; ++j){
-					for (int i = ia; i < ib; ++i){
-						solve<WithBounds, KernelType, DataStorage> (data, i, j, t);
+				if (!solve_slice<KernelType>(local, data, std::array<int, 2>{{ia, ja}}, std::array<int, 2>{{ib, jb}}, t)){
+					for (int j = ja; j < jb; ++j){
+						for (int i = ia; i < ib; ++i){
+							solve<WithBounds, KernelType, DataStorage> (local, data, i, j, t);
+						}
 					}
 				}
+				slice_done<KernelType> (local, t, std::array<int, 2>{{ia, ja}});
 				ia += z.da(0);
 				ib += z.db(0);
 				ja += z.da(1);
@@ -72,9 +123,11 @@ namespace detail {
 			END_INSTUMENT;
 		}
 
-		FOR_DIMENSION(3) base_case (DataStorage& data, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1){
+		FOR_DIMENSION(3) base_case (DataStorage& data, const KernelType& kernel, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1){
 
-			BC_INSTRUMENT(z)
+			BC_INSTRUMENT(z, t0, t1)
+
+			const KernelType local = local_copy(kernel);
 
 			int ia = z.a(0);
 			int ib = z.b(0);
@@ -85,13 +138,16 @@ namespace detail {
 
 			for (int t = t0; t < t1; ++t){
 
-				for (int k = ka; k < kb; ++k){
-					for (int j = ja; j < jb; ++j){
-						for (int i = ia; i < ib; ++i){
-							solve<WithBounds, KernelType, DataStorage> (data, i, j, k, t);
+				if (!solve_slice<KernelType>(local, data, std::array<int, 3>{{ia, ja, ka}}, std::array<int, 3>{{ib, jb, kb}}, t)){
+					for (int k = ka; k < kb; ++k){
+						for (int j = ja; j < jb; ++j){
+							for (int i = ia; i < ib; ++i){
+								solve<WithBounds, KernelType, DataStorage> (local, data, i, j, k, t);
+							}
 						}
 					}
 				}
+				slice_done<KernelType> (local, t, std::array<int, 3>{{ia, ja, ka}});
 				ia += z.da(0);
 				ib += z.db(0);
 				ja += z.da(1);
@@ -103,9 +159,11 @@ namespace detail {
 			END_INSTUMENT;
 		}
 
-		FOR_DIMENSION(4) base_case (DataStorage& data, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1){
+		FOR_DIMENSION(4) base_case (DataStorage& data, const KernelType& kernel, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1){
 
-			BC_INSTRUMENT(z)
+			BC_INSTRUMENT(z, t0, t1)
+
+			const KernelType local = local_copy(kernel);
 
 			int ia = z.a(0);
 			int ib = z.b(0);
@@ -119,15 +177,18 @@ namespace detail {
 			//int t = t0;
 			for (int t = t0; t < t1; ++t){
 
-				for (int w = wa; w < wb; ++w){
-					for (int k = ka; k < kb; ++k){
-						for (int j = ja; j < jb; ++j){
-							for (int i = ia; i < ib; ++i){
-								solve<WithBounds, KernelType, DataStorage> (data, i, j, k, w, t);
+				if (!solve_slice<KernelType>(local, data, std::array<int, 4>{{ia, ja, ka, wa}}, std::array<int, 4>{{ib, jb, kb, wb}}, t)){
+					for (int w = wa; w < wb; ++w){
+						for (int k = ka; k < kb; ++k){
+							for (int j = ja; j < jb; ++j){
+								for (int i = ia; i < ib; ++i){
+									solve<WithBounds, KernelType, DataStorage> (local, data, i, j, k, w, t);
+								}
 							}
 						}
 					}
 				}
+				slice_done<KernelType> (local, t, std::array<int, 4>{{ia, ja, ka, wa}});
 				ia += z.da(0);
 				ib += z.db(0);
 				ja += z.da(1);
@@ -168,28 +229,28 @@ namespace detail {
 
 
 	template <typename DataStorage, typename Kernel, int Dim>
-	inline void recursive_stencil_A(DataStorage& data, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1, Bound_flags leftB, Bound_flags rightB);
+	inline void recursive_stencil_A(DataStorage& data, const Kernel& kernel, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1, Bound_flags leftB, Bound_flags rightB);
 
 	template <typename DataStorage, typename Kernel, int Dim>
-	inline void recursive_stencil_B(DataStorage& data, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1, Bound_flags leftB, Bound_flags rightB);
+	inline void recursive_stencil_B(DataStorage& data, const Kernel& kernel, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1, Bound_flags leftB, Bound_flags rightB);
 
 	// When changing dimension, it is important to see what geometry the hyperspace has, to use the appropiate recursive call
 	template <typename DataStorage, typename Kernel, int Dim>
-	inline void recursive_stencil_dispatch(DataStorage& data, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1, Bound_flags leftB, Bound_flags rightB){
+	inline void recursive_stencil_dispatch(DataStorage& data, const Kernel& kernel, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1, Bound_flags leftB, Bound_flags rightB){
 		const auto da = z.da(Dim);
 		const auto db = z.db(Dim);
 
 		if (da <= db) {
-			recursive_stencil_B<DataStorage, Kernel, Dim> (data, z, t0, t1, leftB, rightB);
+			recursive_stencil_B<DataStorage, Kernel, Dim> (data, kernel, z, t0, t1, leftB, rightB);
 		}
 		else{
-			recursive_stencil_A<DataStorage, Kernel, Dim> (data, z, t0, t1, leftB, rightB);
+			recursive_stencil_A<DataStorage, Kernel, Dim> (data, kernel, z, t0, t1, leftB, rightB);
 		}
 	}
 
 	// This function handles hyperspaces with flat bonduaries, is the entry point.
 	template <typename DataStorage, typename Kernel, int Dim>
-	inline void recursive_stencil_Z(DataStorage& data, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1, Bound_flags leftB, Bound_flags rightB){
+	inline void recursive_stencil_Z(DataStorage& data, const Kernel& kernel, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1, Bound_flags leftB, Bound_flags rightB){
 
 		typedef Hyperspace<DataStorage::dimensions> Target_Hyperspace;
 		constexpr auto NextDim = next_dim<Dim, Target_Hyperspace::dimensions>::value;
@@ -216,11 +277,11 @@ namespace detail {
 			//std::cout << "   			- " << subSpaces[1] << std::endl;
 			//std::cout << "   			- " << subSpaces[2] << std::endl;
 
-			SPAWN ( left, (recursive_stencil_A<DataStorage, Kernel, Dim>), data, subSpaces[0], t0, t1, leftB, REMOVE_BOUND(leftB));
-			recursive_stencil_A<DataStorage, Kernel, Dim>( data, subSpaces[1], t0, t1, REMOVE_BOUND(leftB), rightB);
+			SPAWN_NEAR ( left, zoid_home(data, subSpaces[0], t0, t1), (recursive_stencil_A<DataStorage, Kernel, Dim>), data, kernel, subSpaces[0], t0, t1, leftB, REMOVE_BOUND(leftB));
+			recursive_stencil_A<DataStorage, Kernel, Dim>( data, kernel, subSpaces[1], t0, t1, REMOVE_BOUND(leftB), rightB);
 			SYNC(left);
 
-			recursive_stencil_B<DataStorage, Kernel, Dim>( data, subSpaces[2], t0, t1, leftB, rightB);
+			recursive_stencil_B<DataStorage, Kernel, Dim>( data, kernel, subSpaces[2], t0, t1, leftB, rightB);
 		}
 		// time cut
 		else if (deltaT > TIME_CUTOFF){
@@ -229,7 +290,7 @@ namespace detail {
 			assert(halfTime >= 1);
 			//std::cout << " time cut " << "(" << t0 << "," << halfTime+t0 << "](" << halfTime+t0 << "," << t1 << "]" << std::endl;
 
-			recursive_stencil_Z <DataStorage, Kernel, NextDim>(data, z, t0, t0+halfTime, leftB, rightB);
+			recursive_stencil_Z <DataStorage, Kernel, NextDim>(data, kernel, z, t0, t0+halfTime, leftB, rightB);
 
 			// We must update all the dimensions as we move in time.... 
 			auto upZoid = z;
@@ -238,18 +299,18 @@ namespace detail {
 				upZoid.b(d) = z.b(d) + z.db(d)*halfTime;
 			}
 
-			recursive_stencil_Z<DataStorage, Kernel, NextDim>(data, upZoid, t0+halfTime, t1, leftB, rightB);
+			recursive_stencil_Z<DataStorage, Kernel, NextDim>(data, kernel, upZoid, t0+halfTime, t1, leftB, rightB);
 		}
 		else{
 			//std::cout << "					BASECASE: " << z << " t(" << t0 << "," << t1 << ") lB" << (int)leftB << " rB" << (int)rightB  << std::endl;
-			base_case<DataStorage, Kernel, Target_Hyperspace::dimensions, true> (data, z, t0, t1);
+			base_case<DataStorage, Kernel, Target_Hyperspace::dimensions, true> (data, kernel, z, t0, t1);
 		}
 	}
 
 
 	// This function handles hyperspaces with wider base
 	template <typename DataStorage, typename Kernel, int Dim>
-	inline void recursive_stencil_A(DataStorage& data, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1, Bound_flags leftB, Bound_flags rightB){
+	inline void recursive_stencil_A(DataStorage& data, const Kernel& kernel, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1, Bound_flags leftB, Bound_flags rightB){
 
 		typedef Hyperspace<DataStorage::dimensions> Target_Hyperspace;
 		constexpr auto NextDim = next_dim<Dim, Target_Hyperspace::dimensions>::value;
@@ -275,14 +336,14 @@ namespace detail {
 			//std::cout << "   			- " << subSpaces[1] << std::endl;
 			//std::cout << "   			- " << subSpaces[2] << std::endl;
 
-			SPAWN ( left, (recursive_stencil_A<DataStorage, Kernel, Dim>), data, subSpaces[0], t0, t1, leftB, db==0? rightB: REMOVE_BOUND(rightB));
-			recursive_stencil_A<DataStorage, Kernel, Dim>( data, subSpaces[1], t0, t1, da==0? leftB: REMOVE_BOUND(leftB), rightB);
+			SPAWN_NEAR ( left, zoid_home(data, subSpaces[0], t0, t1), (recursive_stencil_A<DataStorage, Kernel, Dim>), data, kernel, subSpaces[0], t0, t1, leftB, db==0? rightB: REMOVE_BOUND(rightB));
+			recursive_stencil_A<DataStorage, Kernel, Dim>( data, kernel, subSpaces[1], t0, t1, da==0? leftB: REMOVE_BOUND(leftB), rightB);
 			SYNC(left);
 
-			recursive_stencil_B<DataStorage, Kernel, Dim>( data, subSpaces[2], t0, t1, da==0? leftB: REMOVE_BOUND(leftB), db==0? rightB: REMOVE_BOUND(rightB));
+			recursive_stencil_B<DataStorage, Kernel, Dim>( data, kernel, subSpaces[2], t0, t1, da==0? leftB: REMOVE_BOUND(leftB), db==0? rightB: REMOVE_BOUND(rightB));
 		}
 		else if (Dim != 0){
-			recursive_stencil_dispatch<DataStorage, Kernel, NextDim>( data, z, t0, t1, leftB, rightB);
+			recursive_stencil_dispatch<DataStorage, Kernel, NextDim>( data, kernel, z, t0, t1, leftB, rightB);
 		}
 		// time cut
 		else if (deltaT > TIME_CUTOFF){
@@ -291,7 +352,7 @@ namespace detail {
 			assert(halfTime >= 1);
 			//std::cout << " time cut " << halfTime << "(" << t0 << "," << halfTime+t0 << "](" << halfTime+t0 << "," << t1 << "]" << std::endl;
 
-			recursive_stencil_dispatch <DataStorage, Kernel, Dim>(data, z, t0, t0+halfTime, leftB, rightB);
+			recursive_stencil_dispatch <DataStorage, Kernel, Dim>(data, kernel, z, t0, t0+halfTime, leftB, rightB);
 
 			// We must update all the dimensions as we move in time.... 
 			auto upZoid = z;
@@ -300,18 +361,18 @@ namespace detail {
 				upZoid.b(d) = z.b(d) + z.db(d)*halfTime;
 			}
 
-			recursive_stencil_dispatch<DataStorage, Kernel, Dim>(data, upZoid, t0+halfTime, t1, da==0? leftB: REMOVE_BOUND(leftB) , db==0? rightB: REMOVE_BOUND(rightB));
+			recursive_stencil_dispatch<DataStorage, Kernel, Dim>(data, kernel, upZoid, t0+halfTime, t1, da==0? leftB: REMOVE_BOUND(leftB) , db==0? rightB: REMOVE_BOUND(rightB));
 		}
 		else{
 			//std::cout << "					BASECASE: " << z << " t(" << t0 << "," << t1 << ") lB" << (int)leftB << " rB" << (int)rightB  << std::endl;
-			if( leftB + rightB == 0) base_case<DataStorage, Kernel, Target_Hyperspace::dimensions, false> (data, z, t0, t1);
-			else 					 base_case<DataStorage, Kernel, Target_Hyperspace::dimensions, true> (data, z, t0, t1);
+			if( leftB + rightB == 0) base_case<DataStorage, Kernel, Target_Hyperspace::dimensions, false> (data, kernel, z, t0, t1);
+			else 					 base_case<DataStorage, Kernel, Target_Hyperspace::dimensions, true> (data, kernel, z, t0, t1);
 		}
 	}
 
 	// This function handles hyperspaces with wider top (inverted pyramid)
 	template <typename DataStorage, typename Kernel, int Dim>
-	inline void recursive_stencil_B(DataStorage& data, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1, Bound_flags leftB, Bound_flags rightB){
+	inline void recursive_stencil_B(DataStorage& data, const Kernel& kernel, const Hyperspace<DataStorage::dimensions>& z, int t0, int t1, Bound_flags leftB, Bound_flags rightB){
 
 		typedef Hyperspace<DataStorage::dimensions> Target_Hyperspace;
 		constexpr auto NextDim = next_dim<Dim, Target_Hyperspace::dimensions>::value;
@@ -339,15 +400,15 @@ namespace detail {
 			//std::cout << "   			- " << subSpaces[1] << std::endl;
 			//std::cout << "   			- " << subSpaces[2] << std::endl;
 
-			recursive_stencil_A<DataStorage, Kernel, Dim> (data, subSpaces[0], t0, t1, da==0? leftB: REMOVE_BOUND(leftB) , db==0? rightB: REMOVE_BOUND(rightB));
+			recursive_stencil_A<DataStorage, Kernel, Dim> (data, kernel, subSpaces[0], t0, t1, da==0? leftB: REMOVE_BOUND(leftB) , db==0? rightB: REMOVE_BOUND(rightB));
 
-			SPAWN ( left, (recursive_stencil_B<DataStorage, Kernel, Dim>), data, subSpaces[1], t0, t1, leftB, db==0? rightB: REMOVE_BOUND(rightB));
-			recursive_stencil_B<DataStorage, Kernel, Dim>( data, subSpaces[2], t0, t1, da==0? leftB: REMOVE_BOUND(leftB), rightB );
+			SPAWN_NEAR ( left, zoid_home(data, subSpaces[1], t0, t1), (recursive_stencil_B<DataStorage, Kernel, Dim>), data, kernel, subSpaces[1], t0, t1, leftB, db==0? rightB: REMOVE_BOUND(rightB));
+			recursive_stencil_B<DataStorage, Kernel, Dim>( data, kernel, subSpaces[2], t0, t1, da==0? leftB: REMOVE_BOUND(leftB), rightB );
 			SYNC(left);
 
 		}
 		else if (Dim != 0){
-			recursive_stencil_dispatch<DataStorage, Kernel, NextDim>( data, z, t0, t1, leftB, rightB);
+			recursive_stencil_dispatch<DataStorage, Kernel, NextDim>( data, kernel, z, t0, t1, leftB, rightB);
 		}
 		// time cut
 		else if (deltaT > TIME_CUTOFF){
@@ -358,7 +419,7 @@ namespace detail {
 			assert(halfTime >= 1 && halfTime < deltaT);
 
 			//std::cout << " time cut " << halfTime << "(" << t0 << "," << halfTime+t0 << "](" << halfTime+t0 << "," << t1 << "]" << std::endl;
-			recursive_stencil_dispatch<DataStorage, Kernel, NextDim>(data, z, t0, t0+halfTime, da==0? leftB: REMOVE_BOUND(leftB) , db==0? rightB: REMOVE_BOUND(rightB));
+			recursive_stencil_dispatch<DataStorage, Kernel, NextDim>(data, kernel, z, t0, t0+halfTime, da==0? leftB: REMOVE_BOUND(leftB) , db==0? rightB: REMOVE_BOUND(rightB));
 
 			// We must update all the dimensions as we move in time.... 
 			auto upZoid = z;
@@ -367,12 +428,12 @@ namespace detail {
 				upZoid.b(d) = z.b(d) + z.db(d)*halfTime;
 			}
 
-			recursive_stencil_dispatch<DataStorage, Kernel, NextDim>(data, upZoid, t0+halfTime, t1, leftB, rightB);
+			recursive_stencil_dispatch<DataStorage, Kernel, NextDim>(data, kernel, upZoid, t0+halfTime, t1, leftB, rightB);
 		}
 		else {
 			//std::cout << "					BASECASE: " << z << " t(" << t0 << "," << t1 << ") lB" << (int)leftB << " rB" << (int)rightB  << std::endl;
-			if( leftB + rightB == 0) base_case<DataStorage, Kernel, Target_Hyperspace::dimensions, false> (data, z, t0, t1);
-			else 					 base_case<DataStorage, Kernel, Target_Hyperspace::dimensions, true> (data, z, t0, t1);
+			if( leftB + rightB == 0) base_case<DataStorage, Kernel, Target_Hyperspace::dimensions, false> (data, kernel, z, t0, t1);
+			else 					 base_case<DataStorage, Kernel, Target_Hyperspace::dimensions, true> (data, kernel, z, t0, t1);
 		}
 	}
 
@@ -381,15 +442,30 @@ namespace detail {
 
 // ~~~~~~~~~~~~~~~~ Recursive stencil entry point  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
-	template <typename DataStorage, typename Kernel>
-	void recursive_stencil(DataStorage& data, unsigned t){
+namespace detail {
 
-		// 7 (111) is all flags saying that touch the border
-		unsigned char allDims = 1;
-		for (int i =1; i < Kernel::dimensions; i++){
+	// 7 (111) is all flags saying that touch the border
+	template <unsigned Dimensions>
+	inline Bound_flags all_bounds(){
+		Bound_flags allDims = 1;
+		for (unsigned i =1; i < Dimensions; i++){
 			allDims <<=1;
 			allDims += 1;
 		}
+		return allDims;
+	}
+
+	// runs the time steps [t0, t1), the state at t0 must be in the copy of t0
+	template <typename DataStorage, typename Kernel>
+	void recursive_stencil_range(DataStorage& data, const Kernel& kernel, int t0, int t1){
+
+		// nothing to do, and a flat zoid would be cut forever
+		if (t1 <= t0) {
+			data.setTime(t0);
+			return;
+		}
+
+		const auto allDims = all_bounds<Kernel::dimensions>();
 
 		PARALLEL_CTX ({
 
@@ -397,9 +473,104 @@ namespace detail {
 			auto z = data.getGlobalHyperspace();
 
 
-			(detail::recursive_stencil_Z<DataStorage, Kernel, Kernel::dimensions-1>)(data, z, 0, t, allDims, allDims);
+			(detail::recursive_stencil_Z<DataStorage, Kernel, Kernel::dimensions-1>)(data, kernel, z, t0, t1, allDims, allDims);
+
+		});
+
+		data.setTime(t1);
+	}
+
+	// binary spawn tree over the grids [first, last), each leaf is the top zoid of one grid,
+	// so small grids fill the machine together
+	template <typename DataStorage, typename Kernel, typename Iterator>
+	void recursive_stencil_batch_tree(const Kernel& kernel, Iterator first, Iterator last, int t0, int t1){
+
+		const auto count = last - first;
+		if (count == 0) return;
+
+		if (count == 1){
+			DataStorage& data = *first;
+			const auto allDims = all_bounds<Kernel::dimensions>();
+			(recursive_stencil_Z<DataStorage, Kernel, Kernel::dimensions-1>)(data, kernel, data.getGlobalHyperspace(), t0, t1, allDims, allDims);
+			return;
+		}
+
+		const auto middle = first + count/2;
+		SPAWN (left, (recursive_stencil_batch_tree<DataStorage, Kernel, Iterator>), kernel, first, middle, t0, t1);
+		recursive_stencil_batch_tree<DataStorage, Kernel, Iterator>(kernel, middle, last, t0, t1);
+		SYNC(left);
+	}
+
+} // detail
+
+	/**
+	 * Runs t time steps, the input is expected in copy 0.
+	 * Afterwards the buffer time is t, the result is in its current copy.
+	 * The kernel instance carries its parameters, if any (see kernel.h), the versions
+	 * without it are for kernels without fields
+	 */
+	template <typename DataStorage, typename Kernel>
+	void recursive_stencil(DataStorage& data, const Kernel& kernel, unsigned t){
+		detail::recursive_stencil_range<DataStorage, Kernel>(data, kernel, 0, t);
+	}
+
+	template <typename DataStorage, typename Kernel>
+	void recursive_stencil(DataStorage& data, unsigned t){
+		recursive_stencil<DataStorage, Kernel>(data, stateless<Kernel>(), t);
+	}
 
+	/**
+	 * Runs the time steps [t0, t0+steps), the state of time t0 is expected in its copy 
+	 * (t0 % copies), no data is moved around.
+	 * Afterwards the buffer time is t0+steps
+	 */
+	template <typename DataStorage, typename Kernel>
+	void recursive_stencil_from(DataStorage& data, const Kernel& kernel, unsigned t0, unsigned steps){
+		detail::recursive_stencil_range<DataStorage, Kernel>(data, kernel, t0, t0+steps);
+	}
+
+	template <typename DataStorage, typename Kernel>
+	void recursive_stencil_from(DataStorage& data, unsigned t0, unsigned steps){
+		recursive_stencil_from<DataStorage, Kernel>(data, stateless<Kernel>(), t0, steps);
+	}
+
+	/**
+	 * Continues from the current time of the buffer, so a long simulation can be run in chunks.
+	 * returns the new time
+	 */
+	template <typename DataStorage, typename Kernel>
+	unsigned recursive_stencil_advance(DataStorage& data, const Kernel& kernel, unsigned steps){
+		recursive_stencil_from<DataStorage, Kernel>(data, kernel, data.getTime(), steps);
+		return data.getTime();
+	}
+
+	template <typename DataStorage, typename Kernel>
+	unsigned recursive_stencil_advance(DataStorage& data, unsigned steps){
+		return recursive_stencil_advance<DataStorage, Kernel>(data, stateless<Kernel>(), steps);
+	}
+
+	/**
+	 * Runs t time steps on every grid of the batch, all of them in the same parallel context.
+	 * Grids are independent and may have different sizes, the input is expected in copy 0
+	 */
+	template <typename DataStorage, typename Kernel>
+	void recursive_stencil_batch(std::vector<DataStorage>& batch, const Kernel& kernel, unsigned t){
+
+		if (t == 0 || batch.empty()) {
+			for (auto& data : batch) data.setTime(0);
+			return;
+		}
+
+		PARALLEL_CTX ({
+			(detail::recursive_stencil_batch_tree<DataStorage, Kernel, typename std::vector<DataStorage>::iterator>)(kernel, batch.begin(), batch.end(), 0, t);
 		});
+
+		for (auto& data : batch) data.setTime(t);
+	}
+
+	template <typename DataStorage, typename Kernel>
+	void recursive_stencil_batch(std::vector<DataStorage>& batch, unsigned t){
+		recursive_stencil_batch<DataStorage, Kernel>(batch, stateless<Kernel>(), t);
 	}
 
 } // stencil namespace
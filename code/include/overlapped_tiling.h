@@ -0,0 +1,220 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <cassert>
+#include <string.h>
+
+#include "hyperspace.h"
+#include "bufferSet.h"
+#include "dispatch.h"
+#include "roi.h"
+
+
+namespace stencil{
+
+	/**
+	 * Overlapped (ghost zone) tiling, an alternative to the recursive schedule.
+	 * The domain is cut in tiles and time in epochs of k steps. Each tile copies its
+	 * dependency cone (the tile plus neighbours*k points around) into a scratch buffer and runs
+	 * the k steps there on its own, the halo is computed redundantly by neighbouring tiles,
+	 * but tiles never wait for each other within an epoch.
+	 *
+	 * The kernel sees the coordinates of the scratch buffer, points on its edges go through the
+	 * bounded path of the kernel: where the box is cut inside the domain those values differ
+	 * from the real ones, but they do not reach the tile within k steps. Kernels must not depend
+	 * on the absolute position. Only BufferSet storage is supported, read-only fields are
+	 * copied along with the cone.
+	 *
+	 * Scratch buffers are recycled among tiles and epochs, there are as many as tiles running
+	 * at once. The last two steps of a tile go straight to the domain, but for the one
+	 * landing in the copy the epoch reads from, which is staged in a domain sized buffer.
+	 */
+	struct TilingReport{
+		unsigned tiles;			// per epoch
+		unsigned epochs;
+		double redundancy;		// points computed / points of the domain, 1 means no extra work
+	};
+
+namespace detail {
+
+	// copies a box between two buffers, row by row along the first dimension
+	template <typename Elem, size_t Dimensions>
+	void copy_box(Elem* dst, const std::array<size_t, Dimensions>& dstSizes, const std::array<int, Dimensions>& dstOrigin,
+				  const Elem* src, const std::array<size_t, Dimensions>& srcSizes, const std::array<int, Dimensions>& srcOrigin,
+				  const std::array<int, Dimensions>& extent){
+
+		std::array<int, Dimensions> pos;
+		pos.fill(0);
+
+		while (true){
+
+			size_t s = 0, d = 0, srcStride = 1, dstStride = 1;
+			for (unsigned i = 0; i < Dimensions; ++i){
+				s += (srcOrigin[i] + pos[i]) * srcStride;
+				d += (dstOrigin[i] + pos[i]) * dstStride;
+				srcStride *= srcSizes[i];
+				dstStride *= dstSizes[i];
+			}
+			memcpy(dst + d, src + s, extent[0] * sizeof(Elem));
+
+			unsigned i = 1;
+			for (; i < Dimensions; ++i){
+				if (++pos[i] < extent[i]) break;
+				pos[i] = 0;
+			}
+			if (i == Dimensions) return;
+		}
+	}
+
+	// runs the time steps [t0, t1), tile is the size of the tiles, k the steps per epoch
+	template <typename DataStorage, typename Kernel>
+	TilingReport overlapped_tiling_range(DataStorage& data, int t0, int t1, const std::array<int, DataStorage::dimensions>& tile, unsigned k){
+
+		const unsigned Dimensions = DataStorage::dimensions;
+		typedef typename DataStorage::ElementType Elem;
+		typedef std::array<int, DataStorage::dimensions> Coords;
+
+		assert(k > 0);
+		const int halo = Kernel::neighbours * k;
+
+		Coords count;
+		unsigned tiles = 1;
+		size_t points = 1;
+		for (unsigned d = 0; d < Dimensions; ++d){
+			assert(tile[d] > 0);
+			count[d] = (data.dimension_sizes[d] + tile[d] - 1) / tile[d];
+			tiles *= count[d];
+			points *= data.dimension_sizes[d];
+		}
+
+		TilingReport report = {tiles, 0, 1.0};
+		size_t computed = 0;
+		size_t useful = 0;
+
+		typedef std::array<size_t, DataStorage::dimensions> Sizes;
+
+		// scratch buffers not in use, kept along the epochs
+		std::mutex idleLock;
+		std::vector<std::unique_ptr<DataStorage>> idle;
+
+		// an idle scratch of that shape, one of another shape is dropped to keep the count
+		auto take = [&] (const Sizes& sizes){
+			std::unique_ptr<DataStorage> res;
+			{
+				std::lock_guard<std::mutex> guard(idleLock);
+				for (auto& f : idle) if (f->dimension_sizes == sizes) { res.swap(f); break; }
+				if (!res && !idle.empty()) idle.back().reset();
+				idle.erase(std::remove(idle.begin(), idle.end(), nullptr), idle.end());
+			}
+			if (!res){
+				size_t volume = 1;
+				for (auto s : sizes) volume *= s;
+				const std::unique_ptr<Elem[]> zeros (new Elem[volume]());
+				res.reset(new DataStorage(sizes, zeros.get()));
+				for (unsigned f = 0; f < getAuxiliaries(data); ++f) res->attach(zeros.get());
+			}
+			return res;
+		};
+
+		std::unique_ptr<Elem[]> staged;
+
+		for (int t = t0; t < t1; t += k){
+
+			const int steps = MIN((int)k, t1 - t);
+			std::atomic<size_t> work (0);
+
+			// of the last two steps, the one which overwrites the input of the epoch (0 none)
+			int aliased = 0;
+			for (int s = MAX(steps-1, 1); s <= steps; ++s) if (s % DataStorage::copies == 0) aliased = s;
+			if (aliased && !staged) staged.reset(new Elem[points]);
+
+			// phase 1: tiles are independent, each one runs on its own copy of its cone
+			auto compute = [&] (int id){
+
+				Sizes boxSizes;
+				Coords tileOrigin, tileExtent, boxOrigin, boxExtent, zero, inside, flat;
+
+				int rest = id;
+				for (unsigned d = 0; d < Dimensions; ++d){
+					const int size = data.dimension_sizes[d];
+					const int a = (rest % count[d]) * tile[d];
+					const int b = MIN(a + tile[d], size);
+					rest /= count[d];
+
+					tileOrigin[d] = a;
+					tileExtent[d] = b - a;
+					boxOrigin[d] = MAX(a - halo, 0);
+					boxExtent[d] = MIN(b + halo, size) - boxOrigin[d];
+					boxSizes[d] = boxExtent[d];
+
+					zero[d] = 0;
+					flat[d] = 0;
+					inside[d] = a - boxOrigin[d];
+				}
+
+				auto scratch = take(boxSizes);
+				scratch->setTime(0);
+				copy_box<Elem, DataStorage::dimensions>(scratch->getPointer(0), boxSizes, zero,
+							data.getPointer(t % DataStorage::copies), data.dimension_sizes, boxOrigin, boxExtent);
+				for (unsigned f = 0; f < getAuxiliaries(data); ++f){
+					copy_box<Elem, DataStorage::dimensions>(const_cast<Elem*>(scratch->getAuxPointer(f)), boxSizes, zero,
+								data.getAuxPointer(f), data.dimension_sizes, boxOrigin, boxExtent);
+				}
+
+				// only the cone of the tile is computed, not the whole box
+				Coords regionB;
+				for (unsigned d = 0; d < Dimensions; ++d) regionB[d] = inside[d] + tileExtent[d];
+				const Hyperspace<DataStorage::dimensions> region (inside, regionB, flat, flat);
+				recursive_stencil_roi<DataStorage, Kernel>(*scratch, steps, region);
+				work += dependency_cone<DataStorage, Kernel>(*scratch, region, steps).volume(steps);
+
+				// nobody reads the other copies during the epoch
+				for (int s = MAX(steps-1, 1); s <= steps; ++s){
+					Elem* dst = s == aliased? staged.get(): data.getPointer((t+s) % DataStorage::copies);
+					copy_box<Elem, DataStorage::dimensions>(dst, data.dimension_sizes, tileOrigin,
+								scratch->getPointer(s % DataStorage::copies), boxSizes, inside, tileExtent);
+				}
+
+				std::lock_guard<std::mutex> guard(idleLock);
+				idle.push_back(std::move(scratch));
+			};
+
+			P_FOR (id, 0, (int)tiles, 1, { compute(id); });
+
+			// phase 2: everybody finished reading, the staged step takes its place
+			if (aliased){
+				Elem* dst = data.getPointer((t + aliased) % DataStorage::copies);
+				P_FOR (id, 0, (int)tiles, 1, {
+					const size_t begin = points * id / tiles;
+					const size_t end = points * (id+1) / tiles;
+					std::copy(staged.get() + begin, staged.get() + end, dst + begin);
+				});
+			}
+
+			computed += work;
+			useful += points*steps;
+			report.epochs++;
+		}
+
+		data.setTime(t1);
+		if (useful) report.redundancy = (double)computed / useful;
+		return report;
+	}
+
+} // detail
+
+	/**
+	 * Runs t time steps with overlapped tiling, the input is expected in copy 0.
+	 * Afterwards the buffer looks as after recursive_stencil (last two steps in their copies)
+	 */
+	template <typename DataStorage, typename Kernel>
+	TilingReport overlapped_stencil(DataStorage& data, unsigned t, const std::array<int, DataStorage::dimensions>& tile, unsigned k){
+		return detail::overlapped_tiling_range<DataStorage, Kernel>(data, 0, t, tile, k);
+	}
+
+} // stencil namespace
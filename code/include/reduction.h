@@ -0,0 +1,338 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+
+#include "kernel.h"
+#include "bufferSet.h"
+#include "new_rec_stencil.h"
+
+
+namespace stencil{
+
+	/**
+	 * A reduction folds every point produced by the stencil into one value per time step,
+	 * while the traversal happens, so no extra sweep over memory is needed.
+	 * A reduction type provides:
+	 *
+	 *    typedef ... value_type;
+	 *    static value_type identity();
+	 *    static void combine(value_type& acc, const value_type& v);
+	 *    template <typename Elem> static void accumulate(value_type& acc, const Elem& now, const Elem& before);
+	 *
+	 * accumulate is called in the base case right after the kernel computed a point, with
+	 * the new value and the one of the previous time step.
+	 *
+	 * Partial values are kept per thread and per zoid slice, the merge sorts them by time step
+	 * and slice position. The zoid decomposition does not depend on the backend nor on the
+	 * number of threads, therefore the result is bitwise reproducible.
+	 */
+
+namespace detail {
+
+	template <typename Reduction, unsigned Dimensions>
+	class ReductionCollector{
+
+		typedef typename Reduction::value_type value_type;
+
+		struct Record{
+			int t;
+			std::array<int, Dimensions> corner;
+			value_type value;
+		};
+
+		struct Accumulator{
+			value_type partial;
+			bool dirty;
+			std::vector<Record> records;
+
+			Accumulator()
+			: partial(Reduction::identity()), dirty(false)
+			{ }
+		};
+
+		struct ThreadSlot{
+			unsigned long generation;
+			Accumulator* acc;
+		};
+
+		std::mutex lock;
+		std::vector<std::unique_ptr<Accumulator>> accumulators;
+		const unsigned long generation;
+		const int first;
+
+		static std::atomic<unsigned long>& generations(){
+			static std::atomic<unsigned long> count (0);
+			return count;
+		}
+
+		static ReductionCollector*& current(){
+			static ReductionCollector* collector = nullptr;
+			return collector;
+		}
+
+		// accumulators belong to the collector, threads only keep a pointer. Threads might
+		// die before the merge (std::async), their records must survive
+		static Accumulator& local(){
+			static thread_local ThreadSlot slot = {0, nullptr};
+
+			auto self = current();
+			assert(self && "no reduction in progress");
+			if (slot.generation != self->generation){
+				std::lock_guard<std::mutex> guard(self->lock);
+				self->accumulators.emplace_back(new Accumulator());
+				slot.acc = self->accumulators.back().get();
+				slot.generation = self->generation;
+			}
+			return *slot.acc;
+		}
+
+	public:
+
+		// steps before first are not reduced
+		ReductionCollector(int first = 0)
+		: generation(++generations()), first(first)
+		{
+			assert(!current() && "only one reduction of the same type at a time");
+			current() = this;
+		}
+
+		~ReductionCollector(){
+			current() = nullptr;
+		}
+
+		template <typename Elem>
+		static void add(int t, const Elem& now, const Elem& before){
+			if (t < current()->first) return;
+			auto& acc = local();
+			Reduction::accumulate(acc.partial, now, before);
+			acc.dirty = true;
+		}
+
+		static void slice_done(int t, const std::array<int, Dimensions>& corner){
+			auto& acc = local();
+			if (!acc.dirty) return;
+			acc.records.push_back(Record{t, corner, acc.partial});
+			acc.partial = Reduction::identity();
+			acc.dirty = false;
+		}
+
+		// values for the steps [first, t1)
+		std::vector<value_type> merge(int t1){
+
+			std::vector<Record> all;
+			for (const auto& acc : accumulators){
+				all.insert(all.end(), acc->records.begin(), acc->records.end());
+			}
+
+			// same order no matter which thread produced what
+			std::sort(all.begin(), all.end(), [] (const Record& x, const Record& y){
+				if (x.t != y.t) return x.t < y.t;
+				for (int d = Dimensions-1; d >= 0; --d){
+					if (x.corner[d] != y.corner[d]) return x.corner[d] < y.corner[d];
+				}
+				return false;
+			});
+
+			std::vector<value_type> res (MAX(t1-first, 0), Reduction::identity());
+			for (const auto& r : all){
+				assert(r.t >= first && r.t < t1);
+				Reduction::combine(res[r.t-first], r.value);
+			}
+			return res;
+		}
+	};
+
+	template <typename Reduction, unsigned Dimensions>
+	struct ReductionHooks{
+		static void slice_done(int t, const std::array<int, Dimensions>& corner){
+			ReductionCollector<Reduction, Dimensions>::slice_done(t, corner);
+		}
+	};
+
+} // detail
+
+// ~~~~~~~~~~~~~~~~ Kernel wrapper ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	/**
+	 * Wraps a kernel, every computed point is fed to the reduction.
+	 * Whole slices and rows of the wrapped kernel (slice, interior_row) are hidden, they
+	 * would write the points without passing them to the reduction
+	 */
+	template <typename DataStorage, typename KernelType, typename Reduction, unsigned Dimensions = KernelType::dimensions>
+	struct Reduced_k;
+
+	template <typename DataStorage, typename KernelType, typename Reduction>
+	struct Reduced_k<DataStorage, KernelType, Reduction, 1> : public KernelType, public detail::ReductionHooks<Reduction, 1>{
+		typedef detail::ReductionCollector<Reduction, 1> Collector;
+
+		template <typename ... Args> void slice (Args&& ...) const = delete;
+		template <typename ... Args> void interior_row (Args&& ...) const = delete;
+
+		static void withBonduaries (DataStorage& data, int i, int t){
+			KernelType::withBonduaries(data, i, t);
+			Collector::add(t, getElem(data, i, t+1), getElem(data, i, t));
+		}
+		static void withoutBonduaries (DataStorage& data, int i, int t){
+			KernelType::withoutBonduaries(data, i, t);
+			Collector::add(t, getElem(data, i, t+1), getElem(data, i, t));
+		}
+	};
+
+	template <typename DataStorage, typename KernelType, typename Reduction>
+	struct Reduced_k<DataStorage, KernelType, Reduction, 2> : public KernelType, public detail::ReductionHooks<Reduction, 2>{
+		typedef detail::ReductionCollector<Reduction, 2> Collector;
+
+		template <typename ... Args> void slice (Args&& ...) const = delete;
+		template <typename ... Args> void interior_row (Args&& ...) const = delete;
+
+		static void withBonduaries (DataStorage& data, int i, int j, int t){
+			KernelType::withBonduaries(data, i, j, t);
+			Collector::add(t, getElem(data, i, j, t+1), getElem(data, i, j, t));
+		}
+		static void withoutBonduaries (DataStorage& data, int i, int j, int t){
+			KernelType::withoutBonduaries(data, i, j, t);
+			Collector::add(t, getElem(data, i, j, t+1), getElem(data, i, j, t));
+		}
+	};
+
+	template <typename DataStorage, typename KernelType, typename Reduction>
+	struct Reduced_k<DataStorage, KernelType, Reduction, 3> : public KernelType, public detail::ReductionHooks<Reduction, 3>{
+		typedef detail::ReductionCollector<Reduction, 3> Collector;
+
+		template <typename ... Args> void slice (Args&& ...) const = delete;
+		template <typename ... Args> void interior_row (Args&& ...) const = delete;
+
+		static void withBonduaries (DataStorage& data, int i, int j, int k, int t){
+			KernelType::withBonduaries(data, i, j, k, t);
+			Collector::add(t, getElem(data, i, j, k, t+1), getElem(data, i, j, k, t));
+		}
+		static void withoutBonduaries (DataStorage& data, int i, int j, int k, int t){
+			KernelType::withoutBonduaries(data, i, j, k, t);
+			Collector::add(t, getElem(data, i, j, k, t+1), getElem(data, i, j, k, t));
+		}
+	};
+
+	template <typename DataStorage, typename KernelType, typename Reduction>
+	struct Reduced_k<DataStorage, KernelType, Reduction, 4> : public KernelType, public detail::ReductionHooks<Reduction, 4>{
+		typedef detail::ReductionCollector<Reduction, 4> Collector;
+
+		template <typename ... Args> void slice (Args&& ...) const = delete;
+		template <typename ... Args> void interior_row (Args&& ...) const = delete;
+
+		static void withBonduaries (DataStorage& data, int i, int j, int k, int w, int t){
+			KernelType::withBonduaries(data, i, j, k, w, t);
+			Collector::add(t, getElem(data, i, j, k, w, t+1), getElem(data, i, j, k, w, t));
+		}
+		static void withoutBonduaries (DataStorage& data, int i, int j, int k, int w, int t){
+			KernelType::withoutBonduaries(data, i, j, k, w, t);
+			Collector::add(t, getElem(data, i, j, k, w, t+1), getElem(data, i, j, k, w, t));
+		}
+	};
+
+// ~~~~~~~~~~~~~~~~ Entry point ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+	/**
+	 * Same as recursive_stencil, returns the reduction of each time step:
+	 * position s holds the reduction of the values produced by step s (time s+1)
+	 */
+namespace detail {
+
+	// runs the steps [t0, t1), only the steps [first, t1) are reduced
+	template <typename DataStorage, typename Kernel, typename Reduction>
+	std::vector<typename Reduction::value_type> recursive_stencil_reduce_range(DataStorage& data, int t0, int t1, int first){
+
+		assert(t0 <= first && first <= t1);
+		ReductionCollector<Reduction, Kernel::dimensions> collector(first);
+		typedef Reduced_k<DataStorage, Kernel, Reduction> Reduced;
+		recursive_stencil_range<DataStorage, Reduced>(data, stateless<Reduced>(), t0, t1);
+		return collector.merge(t1);
+	}
+
+} // detail
+
+	template <typename DataStorage, typename Kernel, typename Reduction>
+	std::vector<typename Reduction::value_type> recursive_stencil_reduce(DataStorage& data, unsigned t){
+		return detail::recursive_stencil_reduce_range<DataStorage, Kernel, Reduction>(data, 0, t, 0);
+	}
+
+// ~~~~~~~~~~~~~~~~ Some reductions ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+namespace example_reductions{
+
+	/**
+	 * Sum of all values, the total energy for diffusion kernels
+	 */
+	template <typename T = double>
+	struct Sum_r{
+		typedef T value_type;
+
+		static value_type identity() { return 0; }
+		static void combine(value_type& acc, const value_type& v) { acc += v; }
+
+		template <typename Elem>
+		static void accumulate(value_type& acc, const Elem& now, const Elem&){
+			acc += now;
+		}
+	};
+
+	/**
+	 * Largest change of any point, infinity norm of the residual
+	 */
+	template <typename T = double>
+	struct MaxChange_r{
+		typedef T value_type;
+
+		static value_type identity() { return 0; }
+		static void combine(value_type& acc, const value_type& v) { acc = MAX(acc, v); }
+
+		template <typename Elem>
+		static void accumulate(value_type& acc, const Elem& now, const Elem& before){
+			acc = MAX(acc, (value_type) ABS(now - before));
+		}
+	};
+
+	/**
+	 * Sum of the squared changes, square of the L2 norm of the residual
+	 */
+	template <typename T = double>
+	struct SquaredChange_r{
+		typedef T value_type;
+
+		static value_type identity() { return 0; }
+		static void combine(value_type& acc, const value_type& v) { acc += v; }
+
+		template <typename Elem>
+		static void accumulate(value_type& acc, const Elem& now, const Elem& before){
+			const value_type d = now - before;
+			acc += d*d;
+		}
+	};
+
+	/**
+	 * Histogram of the values in [Min, Max), values out of the range fall in the first or last bin
+	 */
+	template <unsigned Bins, int Min, int Max>
+	struct Histogram_r{
+		static_assert(Bins > 0 && Min < Max, "empty histogram");
+		typedef std::array<unsigned long, Bins> value_type;
+
+		static value_type identity() { value_type v; v.fill(0); return v; }
+		static void combine(value_type& acc, const value_type& v) {
+			for (unsigned b = 0; b < Bins; ++b) acc[b] += v[b];
+		}
+
+		template <typename Elem>
+		static void accumulate(value_type& acc, const Elem& now, const Elem&){
+			const double pos = ((double)now - Min) * Bins / (Max - Min);
+			const int bin = pos < 0? 0: pos >= Bins? Bins-1: (int)pos;
+			acc[bin]++;
+		}
+	};
+
+} // example_reductions
+} // stencil namespace
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+
+#include "hyperspace.h"
+#include "new_rec_stencil.h"
+
+
+namespace stencil{
+
+	/**
+	 * Backward dependency cone of a region: the zoid containing every point which has to be
+	 * computed to know the region after steps time steps.
+	 * Going back in time, the region grows by the kernel slope (neighbours) on each side,
+	 * where it reaches the border of the domain the side stays vertical; in that case the cone
+	 * is a bit larger than needed, but it is still a valid zoid for the recursion.
+	 */
+	template <unsigned Dimensions>
+	struct DependencyCone{
+		Hyperspace<Dimensions> zoid;	// base is the first step of the run
+		unsigned char leftB;			// sides which read out of the domain (same flags than the recursion)
+		unsigned char rightB;
+
+		// points computed to get the region
+		size_t volume(unsigned steps) const{
+			size_t res = 0;
+			for (unsigned s = 0; s < steps; ++s){
+				size_t slice = 1;
+				for (unsigned d = 0; d < Dimensions; ++d){
+					const int a = zoid.a(d) + zoid.da(d)*s;
+					const int b = zoid.b(d) + zoid.db(d)*s;
+					slice *= MAX(b-a, 0);
+				}
+				res += slice;
+			}
+			return res;
+		}
+	};
+
+	template <typename DataStorage, typename Kernel>
+	DependencyCone<DataStorage::dimensions> dependency_cone(const DataStorage& data, const Hyperspace<DataStorage::dimensions>& region, unsigned steps){
+
+		const unsigned Dimensions = DataStorage::dimensions;
+		const int n = Kernel::neighbours;
+		assert(steps > 0);
+
+		std::array<int, Dimensions> a, b, da, db;
+		unsigned char leftB = 0, rightB = 0;
+
+		for (unsigned d = 0; d < Dimensions; ++d){
+
+			const int size = data.dimension_sizes[d];
+			assert(region.a(d) >= 0 && region.a(d) < region.b(d) && region.b(d) <= size && "region out of the domain");
+
+			// the last step computes the region itself
+			const int left  = region.a(d) - n*(steps-1);
+			const int right = region.b(d) + n*(steps-1);
+
+			if (left > 0){ a[d] = left; da[d] = n; }
+			else         { a[d] = 0;    da[d] = 0; }
+			if (left - n < 0) leftB |= 1<<d;
+
+			if (right < size){ b[d] = right; db[d] = -n; }
+			else             { b[d] = size;  db[d] = 0; }
+			if (right + n > size) rightB |= 1<<d;
+		}
+
+		return DependencyCone<Dimensions>{ Hyperspace<Dimensions>(a, b, da, db), leftB, rightB };
+	}
+
+	/**
+	 * Runs the time steps [t0, t0+steps) computing only the dependency cone of the region.
+	 * Afterwards only the points of the region hold the right values in the current copy,
+	 * anything outside is undefined.
+	 * The region is a box (flat sides) in the domain.
+	 */
+	template <typename DataStorage, typename Kernel>
+	void recursive_stencil_roi_from(DataStorage& data, unsigned t0, unsigned steps, const Hyperspace<DataStorage::dimensions>& region){
+
+		if (steps == 0) {
+			data.setTime(t0);
+			return;
+		}
+
+		const auto cone = dependency_cone<DataStorage, Kernel>(data, region, steps);
+
+		bool whole = true;
+		for (unsigned d = 0; d < DataStorage::dimensions; ++d){
+			whole = whole && cone.zoid.da(d) == 0 && cone.zoid.db(d) == 0;
+		}
+
+		// the region depends on everything
+		if (whole){
+			detail::recursive_stencil_range<DataStorage, Kernel>(data, stateless<Kernel>(), t0, t0+steps);
+			return;
+		}
+
+		PARALLEL_CTX ({
+			(detail::recursive_stencil_dispatch<DataStorage, Kernel, DataStorage::dimensions-1>)
+								(data, stateless<Kernel>(), cone.zoid, t0, t0+steps, cone.leftB, cone.rightB);
+		});
+
+		data.setTime(t0+steps);
+	}
+
+	/**
+	 * Runs t time steps from copy 0, computes only what is needed for the region
+	 */
+	template <typename DataStorage, typename Kernel>
+	void recursive_stencil_roi(DataStorage& data, unsigned t, const Hyperspace<DataStorage::dimensions>& region){
+		recursive_stencil_roi_from<DataStorage, Kernel>(data, 0, t, region);
+	}
+
+} // stencil namespace
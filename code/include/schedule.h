@@ -0,0 +1,10 @@
+#pragma once
+
+
+namespace stencil{
+
+	// loop schedules for P_FOR_SCHED, as in OpenMP. The chunk is the number of iterations
+	// handed out at once, 0 lets the backend decide
+	enum class Schedule { Static, Dynamic, Guided };
+
+} // stencil namespace
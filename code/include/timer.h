@@ -4,6 +4,13 @@
 #include <iomanip>
 #include <ctime>
 #include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#ifdef __unix__
+#	include <sys/resource.h>
+#endif
 
 //#include <functional>
 //#include <time.h>
@@ -18,3 +25,158 @@ double time_call (F f, ARGS& ... args){
     std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
     return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / (1000.0);
 }
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~ repeated measures ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+/**
+ * A single call pays first touch page faults, cold caches and frequency ramp up.
+ * time_repetitions runs warmup calls first, then repetitions timed calls, with an untimed
+ * reset before each of them (restore the input buffers). Statistics are robust:
+ *  - median and MAD (median absolute deviation, scaled to a stddev for normal data)
+ *  - 95% confidence interval of the median, from order statistics, [min, max] below 6 samples
+ *  - samples further than outlier MADs from the median are flagged and left out of mean and stddev
+ * With rusage, page faults and context switches of the process are counted per sample.
+ */
+struct TimingConfig{
+	unsigned warmup;
+	unsigned repetitions;
+	double outlier;
+	bool rusage;
+
+	TimingConfig(unsigned warmup = 1, unsigned repetitions = 10, double outlier = 3.0, bool rusage = false)
+	: warmup(warmup), repetitions(repetitions), outlier(outlier), rusage(rusage) {}
+};
+
+struct TimingSample{
+	double ms;
+	long minorFaults, majorFaults;
+	long voluntarySwitches, involuntarySwitches;
+	bool outlier;
+};
+
+struct Timing{
+	std::vector<TimingSample> samples;
+	double median, mad;
+	double ciLow, ciHigh;			// of the median
+	double min, max;
+	double mean, stddev;			// without outliers
+	unsigned outliers;
+};
+
+namespace detail_timer{
+
+	struct Usage{
+		long minorFaults, majorFaults, voluntarySwitches, involuntarySwitches;
+	};
+
+	inline Usage usage(){
+#ifdef __unix__
+		rusage u;
+		getrusage(RUSAGE_SELF, &u);
+		return Usage{u.ru_minflt, u.ru_majflt, u.ru_nvcsw, u.ru_nivcsw};
+#else
+		return Usage{0, 0, 0, 0};
+#endif
+	}
+
+	inline double median(std::vector<double> v){
+		std::sort(v.begin(), v.end());
+		const size_t n = v.size();
+		return n % 2? v[n/2]: (v[n/2-1] + v[n/2]) / 2;
+	}
+}
+
+// fills the statistics of the samples, scale is 1.4826 so MAD estimates a stddev
+inline void timing_statistics(Timing& res, double outlier = 3.0){
+
+	const size_t n = res.samples.size();
+	res.outliers = 0;
+	if (n == 0) {
+		res.median = res.mad = res.ciLow = res.ciHigh = res.min = res.max = res.mean = res.stddev = 0;
+		return;
+	}
+
+	std::vector<double> times;
+	for (const auto& s : res.samples) times.push_back(s.ms);
+	std::sort(times.begin(), times.end());
+
+	res.min = times.front();
+	res.max = times.back();
+	res.median = detail_timer::median(times);
+
+	std::vector<double> deviations;
+	for (double t : times) deviations.push_back(std::abs(t - res.median));
+	res.mad = 1.4826 * detail_timer::median(deviations);
+
+	// ranks n/2 -+ 1.96*sqrt(n)/2 around the median (1 based)
+	if (n >= 6){
+		const double half = 0.98 * std::sqrt((double)n);
+		const int low = std::max((int)std::floor(n/2.0 - half), 1);
+		const int high = std::min((int)std::ceil(1 + n/2.0 + half), (int)n);
+		res.ciLow = times[low-1];
+		res.ciHigh = times[high-1];
+	}
+	else {
+		res.ciLow = res.min;
+		res.ciHigh = res.max;
+	}
+
+	double sum = 0;
+	unsigned kept = 0;
+	for (auto& s : res.samples){
+		s.outlier = std::abs(s.ms - res.median) > outlier * res.mad && res.mad > 0;
+		if (s.outlier) { res.outliers++; continue; }
+		sum += s.ms;
+		kept++;
+	}
+	res.mean = sum / kept;
+
+	double squares = 0;
+	for (const auto& s : res.samples) if (!s.outlier) squares += (s.ms - res.mean)*(s.ms - res.mean);
+	res.stddev = kept > 1? std::sqrt(squares / (kept-1)): 0;
+}
+
+template<typename R, typename F>
+Timing time_repetitions (const TimingConfig& config, R reset, F f){
+
+	for (unsigned i = 0; i < config.warmup; ++i){
+		reset();
+		f();
+	}
+
+	Timing res;
+	for (unsigned i = 0; i < config.repetitions; ++i){
+		reset();
+
+		TimingSample s = TimingSample();
+		const auto before = config.rusage? detail_timer::usage(): detail_timer::Usage();
+		const auto start = std::chrono::steady_clock::now();
+
+		f();
+
+		const auto end = std::chrono::steady_clock::now();
+		s.ms = std::chrono::duration<double, std::milli>(end - start).count();
+		if (config.rusage){
+			const auto after = detail_timer::usage();
+			s.minorFaults = after.minorFaults - before.minorFaults;
+			s.majorFaults = after.majorFaults - before.majorFaults;
+			s.voluntarySwitches = after.voluntarySwitches - before.voluntarySwitches;
+			s.involuntarySwitches = after.involuntarySwitches - before.involuntarySwitches;
+		}
+		res.samples.push_back(s);
+	}
+
+	timing_statistics(res, config.outlier);
+	return res;
+}
+
+template<typename F>
+Timing time_repetitions (const TimingConfig& config, F f){
+	return time_repetitions(config, [] () {}, f);
+}
+
+inline std::ostream& operator<< (std::ostream& os, const Timing& t){
+	return os << std::fixed << std::setprecision(3) << t.median << "ms (MAD " << t.mad
+			  << ", 95% [" << t.ciLow << ", " << t.ciHigh << "], min " << t.min << ", "
+			  << t.samples.size() << " runs, " << t.outliers << " outliers)";
+}
@@ -1,8 +1,14 @@
 #pragma once
-#include "stopwatch.h"
-#include "hyperspace.h"
+#include "trace.h"
 
-#include <sstream>
+// hardware counters around each base case, on their own or on top of INSTRUMENT
+#ifdef PERF_COUNTERS
+#	include "perf_counters.h"
+#	define PERF_INSTRUMENT(Z, T0, T1) \
+			auto swperf = stencil::perf::sample(Z, T0, T1);
+#else
+#	define PERF_INSTRUMENT(Z, T0, T1)
+#endif
 
 #ifdef INSTRUMENT
 
@@ -10,41 +16,30 @@
 namespace instrument{
 
 	template <typename T >
-	uibk::StopWatch::swTicket instrument_base_case(const T &z){
-
-		std::stringstream ss;
-		for (int i=0; i < T::dimensions; ++i){
-			if (z.da(i) >= z.db(i)) ss << "A";
-			else ss << "B";
-		}
-		ss << "\t" << z.getStep();
-		return uibk::StopWatch::start(ss.str()); 
+	stencil::trace::Scope instrument_base_case(const T &z, int t0, int t1){
+		static const auto event = stencil::trace::intern("base");
+		return stencil::trace::Scope(event, t0, t1, 0, T::dimensions, stencil::trace::shape(z), stencil::trace::volume(z, t0, t1));
 	}
 	
 	template <typename T >
-	uibk::StopWatch::swTicket instrument_split(const T &z){
-
-		std::stringstream ss;
-		ss << "split";
-		ss << "\t" << z.getStep();
-		return uibk::StopWatch::start(ss.str()); 
+	stencil::trace::Scope instrument_split(const T &z){
+		static const auto event = stencil::trace::intern("split");
+		return stencil::trace::Scope(event, 0, 0, 0, T::dimensions, stencil::trace::shape(z));
 	}
 
-	uibk::StopWatch::swTicket instrument_loop(int x, int t){
-
-		std::stringstream ss;
-		ss << "Chunk"; // << x;
-		ss << "\t" << t;
-		return uibk::StopWatch::start(ss.str()); 
+	inline stencil::trace::Scope instrument_loop(int x, int t){
+		static const auto event = stencil::trace::intern("Chunk");
+		return stencil::trace::Scope(event, t, t+1, x);
 	}
 	
- 	void instrument_end(uibk::StopWatch::swTicket& t){
-		return uibk::StopWatch::stop(t); 
+ 	inline void instrument_end(stencil::trace::Scope& t){
+		t.end();
 	}
 
 }
-	#define BC_INSTRUMENT(Z) \
-			auto swt = instrument::instrument_base_case(Z);
+	#define BC_INSTRUMENT(Z, T0, T1) \
+			auto swt = instrument::instrument_base_case(Z, T0, T1); \
+			PERF_INSTRUMENT(Z, T0, T1)
 
 	#define SPLIT_INSTRUMENT(Z) \
 			auto swt = instrument::instrument_split(Z);
@@ -55,9 +50,13 @@ namespace instrument{
 	#define END_INSTUMENT \
 			instrument::instrument_end(swt);
 
+	// first thing in the body of a spawned task
+	#define TASK_INSTRUMENT \
+			stencil::trace::Task swtask;
+
 #else
-	#define BC_INSTRUMENT(Z) \
-		;
+	#define BC_INSTRUMENT(Z, T0, T1) \
+		PERF_INSTRUMENT(Z, T0, T1)
 
 	#define SPLIT_INSTRUMENT(K) \
 		;
@@ -68,4 +67,7 @@ namespace instrument{
 	#define END_INSTUMENT \
 		;
 
+	#define TASK_INSTRUMENT \
+		;
+
 #endif
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+
+namespace stencil{
+namespace profile{
+
+	/**
+	 * Work/span analysis of the parallel structure, in the style of Cilkview.
+	 * With -DPROFILE_PARALLELISM the program runs serially and every SPAWN, SYNC and
+	 * parallel loop is accounted on a shadow stack of frames:
+	 *  work	 total time of all strands
+	 *  span	 time of the longest chain of dependent strands
+	 *  burdened span includes a scheduling cost per spawn (STENCIL_SPAWN_BURDEN, microseconds,
+	 *			 5 by default), which is what small tasks really pay
+	 * parallelism = work/span is the most a machine could speed the region up.
+	 * Results are kept per parallel region call site and printed at exit.
+	 */
+	struct Region{
+		std::string where;
+		unsigned long calls;
+		double work;				// seconds
+		double span;
+		double burdenedSpan;
+		std::vector<unsigned long> spawns;	// by depth, the number of spawned ancestors
+
+		double parallelism() const { return span > 0? work / span: 1; }
+		double burdenedParallelism() const { return burdenedSpan > 0? work / burdenedSpan: 1; }
+
+		// greedy scheduler bound (Brent): T_P <= work/P + burdened span
+		double speedup(unsigned cores) const {
+			const double tp = work / cores + burdenedSpan;
+			return tp > 0? work / tp: 1;
+		}
+	};
+
+	inline double wall_clock(){
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	class Profiler{
+
+		struct Frame{
+			double prefix, longest;						// span of the continuation, of the longest child since the last sync
+			double burdenedPrefix, burdenedLongest;
+		};
+
+		double (*clock)();
+		double burden;
+		double last;
+		std::vector<Frame> stack;
+		std::vector<Region> regions;
+		Region* current;
+
+		// the strand that just finished belongs to the frame on top
+		void account(){
+			const double now = clock();
+			const double elapsed = now - last;
+			last = now;
+			if (stack.empty()) return;
+			current->work += elapsed;
+			stack.back().prefix += elapsed;
+			stack.back().burdenedPrefix += elapsed;
+		}
+
+		Frame closed(){
+			Frame f = stack.back();
+			stack.pop_back();
+			f.prefix = std::max(f.prefix, f.longest);
+			f.burdenedPrefix = std::max(f.burdenedPrefix, f.burdenedLongest);
+			return f;
+		}
+
+	public:
+
+		explicit Profiler(double (*clock)() = wall_clock, double burden = -1)
+		: clock(clock), burden(burden), last(clock()), current(nullptr)
+		{
+			if (this->burden < 0){
+				const char* env = std::getenv("STENCIL_SPAWN_BURDEN");
+				this->burden = (env? std::atof(env): 5.0) * 1e-6;
+			}
+		}
+
+		~Profiler(){
+			if (!regions.empty() && clock == wall_clock) report(std::cerr);
+		}
+
+		static Profiler& instance(){
+			static Profiler profiler;
+			return profiler;
+		}
+
+		// an outermost parallel region opens a frame, nested ones are just code
+		bool begin_region(const std::string& where){
+			if (!stack.empty()) return false;
+			auto it = std::find_if(regions.begin(), regions.end(), [&] (const Region& r) { return r.where == where; });
+			if (it == regions.end()){
+				regions.push_back(Region{where, 0, 0, 0, 0, {}});
+				it = regions.end()-1;
+			}
+			current = &*it;
+			current->calls++;
+			last = clock();
+			stack.push_back(Frame{0, 0, 0, 0});
+			return true;
+		}
+
+		void end_region(){
+			account();
+			const Frame f = closed();
+			// calls of the same region run one after the other, their spans add up
+			current->span += f.prefix;
+			current->burdenedSpan += f.burdenedPrefix;
+		}
+
+		void begin_spawn(){
+			if (stack.empty()) return;
+			account();
+			const size_t depth = stack.size()-1;
+			if (current->spawns.size() <= depth) current->spawns.resize(depth+1, 0);
+			current->spawns[depth]++;
+			stack.push_back(Frame{0, 0, 0, 0});
+		}
+
+		// the end of a spawned function is an implicit sync
+		void end_spawn(){
+			if (stack.size() < 2) return;
+			account();
+			const Frame child = closed();
+			auto& parent = stack.back();
+			parent.longest = std::max(parent.longest, parent.prefix + child.prefix);
+			parent.burdenedLongest = std::max(parent.burdenedLongest, parent.burdenedPrefix + child.burdenedPrefix + burden);
+		}
+
+		void sync(){
+			if (stack.empty()) return;
+			account();
+			auto& f = stack.back();
+			f.prefix = std::max(f.prefix, f.longest);
+			f.burdenedPrefix = std::max(f.burdenedPrefix, f.burdenedLongest);
+			f.longest = f.burdenedLongest = 0;
+		}
+
+		const std::vector<Region>& getRegions() const{
+			return regions;
+		}
+
+		void report(std::ostream& os) const{
+			os << "================ parallelism profile ================" << std::endl;
+			for (const auto& r : regions){
+				os << r.where << "  (" << r.calls << " calls)" << std::endl;
+				os << std::fixed << std::setprecision(3)
+				   << "  work " << r.work*1e3 << "ms  span " << r.span*1e3 << "ms  burdened span " << r.burdenedSpan*1e3 << "ms" << std::endl
+				   << std::setprecision(2)
+				   << "  parallelism " << r.parallelism() << "  burdened parallelism " << r.burdenedParallelism() << std::endl
+				   << "  speedup bound";
+				for (unsigned p = 2; p <= 64; p *= 2) os << "  " << p << ":" << r.speedup(p);
+				os << std::endl << "  spawns by depth";
+				for (unsigned d = 0; d < r.spawns.size(); ++d) os << " " << r.spawns[d];
+				os << std::endl;
+			}
+			os << "=====================================================" << std::endl;
+		}
+	};
+
+	// scoped helpers for the dispatch macros
+	struct RegionScope{
+		bool outermost;
+		RegionScope(const char* file, int line)
+		: outermost(Profiler::instance().begin_region(std::string(file) + ":" + std::to_string(line))) {}
+		~RegionScope(){
+			if (outermost) Profiler::instance().end_region();
+		}
+	};
+
+	struct SpawnScope{
+		SpawnScope() { Profiler::instance().begin_spawn(); }
+		~SpawnScope() { Profiler::instance().end_spawn(); }
+	};
+
+	inline void sync(){
+		Profiler::instance().sync();
+	}
+
+	inline void report(std::ostream& os = std::cout){
+		Profiler::instance().report(os);
+	}
+
+} // profile
+} // stencil namespace
@@ -0,0 +1,390 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#ifdef __linux__
+#	include <unistd.h>
+#	include <sys/syscall.h>
+#	include <sys/ioctl.h>
+#	include <linux/perf_event.h>
+#endif
+
+#include "trace.h"
+
+
+namespace stencil{
+namespace perf{
+
+	/**
+	 * Per thread hardware counters (perf_event_open) around the base cases.
+	 *
+	 * STENCIL_PERF_EVENTS  comma separated list, at most TRACE_COUNTERS, default
+	 *                      cycles,instructions,llc-misses,l1d-misses
+	 * STENCIL_PERF_SAMPLE  measure one of every N base cases of each thread, default 1
+	 *
+	 * Events which can not be opened are dropped, if no hardware event is left the
+	 * software ones (task-clock, page-faults, context-switches) are used instead. Threads
+	 * which can not open the same events as the first one are not counted.
+	 * When the kernel multiplexes the counters, deltas are scaled by the time the group was
+	 * enabled over the time it was counting, base cases it never counted are dropped.
+	 * The counters of a thread go back to the registry when it exits, the next new thread
+	 * reuses them (no perf_event_open per spawned task under CXX_ASYNC).
+	 * Each sampled base case is written to the trace with its deltas, and the totals per
+	 * zoid shape class are written to counters.txt at exit, when built with PERF_COUNTERS.
+	 */
+
+	struct Event{
+		const char* name;
+		uint32_t type;
+		uint64_t config;
+		bool hardware;
+	};
+
+namespace detail {
+
+#ifdef __linux__
+	inline uint64_t cache_event(uint64_t cache, uint64_t result){
+		return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+	}
+
+	inline const std::vector<Event>& known_events(){
+		static const std::vector<Event> events = {
+			{"cycles",			PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CPU_CYCLES, true},
+			{"instructions",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_INSTRUCTIONS, true},
+			{"cache-misses",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_CACHE_MISSES, true},
+			{"branch-misses",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_BRANCH_MISSES, true},
+			{"stalls-frontend",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_STALLED_CYCLES_FRONTEND, true},
+			{"stalls-backend",	PERF_TYPE_HARDWARE,	PERF_COUNT_HW_STALLED_CYCLES_BACKEND, true},
+			{"llc-misses",		PERF_TYPE_HW_CACHE,	cache_event(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_RESULT_MISS), true},
+			{"l1d-misses",		PERF_TYPE_HW_CACHE,	cache_event(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS), true},
+			{"task-clock",		PERF_TYPE_SOFTWARE,	PERF_COUNT_SW_TASK_CLOCK, false},
+			{"page-faults",		PERF_TYPE_SOFTWARE,	PERF_COUNT_SW_PAGE_FAULTS, false},
+			{"context-switches",PERF_TYPE_SOFTWARE,	PERF_COUNT_SW_CONTEXT_SWITCHES, false},
+			{"cpu-migrations",	PERF_TYPE_SOFTWARE,	PERF_COUNT_SW_CPU_MIGRATIONS, false},
+		};
+		return events;
+	}
+
+	// counter of the calling thread, -1 if not available
+	inline int open_event(const Event& e, int group){
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = e.type;
+		attr.config = e.config;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+	}
+#else
+	inline const std::vector<Event>& known_events(){
+		static const std::vector<Event> events;
+		return events;
+	}
+
+	inline int open_event(const Event&, int){
+		return -1;
+	}
+#endif
+
+	inline std::vector<std::string> split(const std::string& list){
+		std::vector<std::string> res;
+		std::stringstream ss (list);
+		std::string item;
+		while (std::getline(ss, item, ',')) if (!item.empty()) res.push_back(item);
+		return res;
+	}
+
+	// one group of counters, read with a single syscall
+	class Group{
+
+		std::vector<int> fds;
+		std::vector<std::string> names;
+
+	public:
+
+		explicit Group(const std::vector<std::string>& requested){
+			for (const auto& name : requested){
+				if (fds.size() == TRACE_COUNTERS) break;
+				for (const auto& e : known_events()){
+					if (name != e.name) continue;
+					const int fd = open_event(e, fds.empty()? -1: fds[0]);
+					if (fd >= 0) { fds.push_back(fd); names.push_back(name); }
+				}
+			}
+		}
+
+		~Group(){
+#ifdef __linux__
+			for (int fd : fds) close(fd);
+#endif
+		}
+
+		Group(const Group&) = delete;
+
+		const std::vector<std::string>& getNames() const{
+			return names;
+		}
+
+		// values of the counters, and how long the group was enabled and actually counting
+		bool read(uint64_t* values, uint64_t& enabled, uint64_t& running) const{
+#ifdef __linux__
+			if (fds.empty()) return false;
+			uint64_t buffer[TRACE_COUNTERS+3];
+			if (::read(fds[0], buffer, sizeof(buffer)) <= 0) return false;
+			enabled = buffer[1];
+			running = buffer[2];
+			for (unsigned i = 0; i < names.size(); ++i) values[i] = buffer[i+3];
+			return true;
+#else
+			return false;
+#endif
+		}
+	};
+
+	struct Totals{
+		uint64_t calls;
+		uint64_t volume;
+		uint64_t values[TRACE_COUNTERS];
+	};
+
+	// zoid classes: dimensions 1..4 times the A/B patterns
+	const unsigned Classes = 4*16;
+
+	// counters and totals of a thread, only used if its events are the ones of the registry
+	struct Thread{
+		Group group;
+		std::unique_ptr<Totals[]> table;
+		unsigned count;
+		bool matches;
+
+		explicit Thread(const std::vector<std::string>& names)
+		: group(names), table(new Totals[Classes]()), count(0), matches(group.getNames() == names) {}
+	};
+
+	// the counters of a thread, given back to the registry when the thread exits
+	struct Owner{
+		Thread* thread;
+
+		Owner() : thread(nullptr) {}
+		~Owner();
+	};
+
+	class Registry{
+
+		std::mutex lock;
+		std::vector<std::unique_ptr<Thread>> threads;
+		std::vector<Thread*> idle;		// of threads which exited
+		std::vector<std::string> names;
+		std::vector<std::string> requested;
+		unsigned ratio;
+
+	public:
+
+		Registry()
+		: ratio(1)
+		{
+			const char* events = std::getenv("STENCIL_PERF_EVENTS");
+			requested = split(events? events: "cycles,instructions,llc-misses,l1d-misses");
+			const char* sample = std::getenv("STENCIL_PERF_SAMPLE");
+			if (sample && std::atoi(sample) > 0) ratio = std::atoi(sample);
+
+			// find out what this machine can count, software events otherwise
+			Group probe (requested);
+			bool hardware = false;
+			for (const auto& name : probe.getNames()){
+				for (const auto& e : known_events()) if (name == e.name && e.hardware) hardware = true;
+			}
+			if (!hardware) requested = {"task-clock", "page-faults", "context-switches"};
+			names = Group(requested).getNames();
+			trace::counter_names(names);
+		}
+
+		~Registry(){
+#ifdef PERF_COUNTERS
+			if (threads.empty() || names.empty()) return;
+			std::ofstream out ("counters.txt");
+			report(out);
+#endif
+		}
+
+		static Registry& instance(){
+			static Registry registry;
+			return registry;
+		}
+
+		const std::vector<std::string>& getRequested() const{
+			return requested;
+		}
+
+		const std::vector<std::string>& getNames() const{
+			return names;
+		}
+
+		unsigned getRatio() const{
+			return ratio;
+		}
+
+		// the counters of the calling thread, the ones of an exited thread if any: no new
+		// table nor perf_event_open per thread when every spawn is a thread
+		Thread& mine(){
+			static thread_local Owner owner;
+			if (!owner.thread){
+				{
+					std::lock_guard<std::mutex> guard(lock);
+					if (!idle.empty()){
+						owner.thread = idle.back();
+						idle.pop_back();
+					}
+				}
+				if (!owner.thread){
+					std::unique_ptr<Thread> fresh (new Thread(names));
+					std::lock_guard<std::mutex> guard(lock);
+					owner.thread = fresh.get();
+					threads.push_back(std::move(fresh));
+				}
+			}
+			return *owner.thread;
+		}
+
+		void release(Thread* thread){
+			std::lock_guard<std::mutex> guard(lock);
+			idle.push_back(thread);
+		}
+
+		size_t thread_count(){
+			std::lock_guard<std::mutex> guard(lock);
+			return threads.size();
+		}
+
+		// totals per class, merged over threads
+		std::vector<Totals> totals(){
+			std::lock_guard<std::mutex> guard(lock);
+			std::vector<Totals> res (Classes, Totals());
+			for (const auto& thread : threads){
+				const auto* t = thread->table.get();
+				for (unsigned c = 0; c < Classes; ++c){
+					res[c].calls += t[c].calls;
+					res[c].volume += t[c].volume;
+					for (unsigned i = 0; i < TRACE_COUNTERS; ++i) res[c].values[i] += t[c].values[i];
+				}
+			}
+			return res;
+		}
+
+		void report(std::ostream& os){
+			const auto all = totals();
+			os << "shape\tsampled\tpoints";
+			for (const auto& n : names) os << "\t" << n << "\t" << n << "/point";
+			os << std::endl;
+			for (unsigned c = 0; c < Classes; ++c){
+				if (!all[c].calls) continue;
+				trace::Record r = trace::Record();
+				r.dims = c / 16 + 1;
+				r.shape = c % 16;
+				os << trace::detail::shape_name(r) << "\t" << all[c].calls << "\t" << all[c].volume;
+				for (unsigned i = 0; i < names.size(); ++i){
+					os << "\t" << all[c].values[i] << "\t" << std::fixed << std::setprecision(3)
+					   << (all[c].volume? (double)all[c].values[i] / all[c].volume: 0.0);
+				}
+				os << std::endl;
+			}
+		}
+	};
+
+	inline Owner::~Owner(){
+		if (thread) Registry::instance().release(thread);
+	}
+
+} // detail
+
+	inline const std::vector<std::string>& counter_names(){
+		return detail::Registry::instance().getNames();
+	}
+
+	inline bool available(){
+		return !counter_names().empty();
+	}
+
+	/**
+	 * counts a base case (if sampled), adds the deltas to its class and to the trace
+	 */
+	class Sample{
+		trace::Record r;
+		detail::Thread* thread;
+		uint64_t enabled, running;
+	public:
+
+		Sample(unsigned dims, unsigned shape, int t0, int t1, uint64_t volume)
+		: thread(nullptr), enabled(0), running(0)
+		{
+			auto& mine = detail::Registry::instance().mine();
+			if (mine.count++ % detail::Registry::instance().getRatio() || !mine.matches) return;
+			static const auto event = trace::intern("counters");
+			r = trace::Record();
+			r.event = event;
+			r.t0 = t0;
+			r.t1 = t1;
+			r.dims = dims;
+			r.shape = shape;
+			r.task = trace::detail::current_task();
+			r.volume = volume;
+			if (!mine.group.read(r.counters, enabled, running)) return;
+			thread = &mine;
+			r.start = trace::ticks();
+		}
+
+		Sample(const Sample&) = delete;
+
+		Sample(Sample&& o)
+		: r(o.r), thread(o.thread), enabled(o.enabled), running(o.running) {
+			o.thread = nullptr;
+		}
+
+		~Sample(){
+			if (!thread) return;
+			uint64_t end[TRACE_COUNTERS], endEnabled, endRunning;
+			r.end = trace::ticks();
+			if (!thread->group.read(end, endEnabled, endRunning)) return;
+
+			// multiplexed: extrapolate to the whole base case, nothing to say if never counted
+			const uint64_t counted = endRunning - running;
+			if (!counted) return;
+			const double scale = (double)(endEnabled - enabled) / counted;
+
+			const unsigned n = thread->group.getNames().size();
+			auto& totals = thread->table[((r.dims - 1) * 16 + r.shape) % detail::Classes];
+			totals.calls++;
+			totals.volume += r.volume;
+			for (unsigned i = 0; i < n; ++i){
+				r.counters[i] = end[i] - r.counters[i];
+				if (scale > 1) r.counters[i] = r.counters[i] * scale;
+				totals.values[i] += r.counters[i];
+			}
+			r.ncounters = n;
+			trace::record(r);
+		}
+	};
+
+	template <typename Zoid>
+	inline Sample sample(const Zoid& z, int t0, int t1){
+		return Sample(Zoid::dimensions, trace::shape(z), t0, t1, trace::volume(z, t0, t1));
+	}
+
+	// totals per shape class, as in counters.txt
+	inline void report(std::ostream& os){
+		detail::Registry::instance().report(os);
+	}
+
+} // perf
+} // stencil namespace
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <iostream>
+#include <type_traits>
+
+#include "bufferSet.h"
+#include "dispatch.h"
+#include "tools/topology.h"
+
+
+namespace stencil{
+namespace roofline{
+
+	/**
+	 * Throughput of a run placed against the roofline of the machine.
+	 * The machine is probed once: memory bandwidth with a STREAM triad, floating point
+	 * peak with independent multiply-add chains, both with the threads of the backend.
+	 * The traffic of the stencil is a model, for a plain sweep per time step:
+	 *   - read, write and write allocate, 3 elements per point, if 2*neighbours+1 planes of
+	 *     the slowest dimension fit in half the last level cache (layer condition)
+	 *   - otherwise every plane is read again, 2*neighbours+1 reads plus 2 per point
+	 * Read-only fields of the storage (see BufferSet::attach) add one read per point each,
+	 * and their planes count for the layer condition.
+	 * Engines with temporal blocking move less, an effective bandwidth above the machine
+	 * one is the sign of it. Kernels may declare their flops per point with a static
+	 * member flops, otherwise one multiply-add per point of the (2n+1)^D box is assumed.
+	 */
+	struct Machine{
+		double bandwidth;		// bytes/s
+		double flops;			// flop/s
+		unsigned threads;
+	};
+
+	struct Report{
+		std::string engine;
+		double ms;
+		double points;			// updates, points * time steps
+		double pointsPerSecond;
+		double bytesPerPoint;
+		double flopsPerPoint;
+		double bandwidth;		// achieved bytes/s, model traffic over time
+		double flopRate;		// achieved flop/s
+		double intensity;		// flop/byte
+		double attainable;		// roofline flop/s at this intensity
+		double efficiency;		// flopRate / attainable
+		const char* bound;		// "bandwidth" or "compute"
+	};
+
+namespace detail {
+
+	template <typename Kernel, typename = void>
+	struct declared_flops{
+		static const unsigned value = 0;
+		static const bool declared = false;
+	};
+
+	template <typename Kernel>
+	struct declared_flops<Kernel, typename std::enable_if<sizeof(Kernel::flops) != 0>::type>{
+		static const unsigned value = Kernel::flops;
+		static const bool declared = true;
+	};
+
+	inline unsigned backend_threads(){
+		const unsigned hw = std::max(std::thread::hardware_concurrency(), 1u);
+		return std::min((unsigned)MAX_THREADS, hw);
+	}
+
+	// size in bytes of the last level cache, 0 if unknown
+	inline size_t last_level_cache(const std::string& root = "/sys/devices/system"){
+		size_t res = 0;
+		for (int index = 0; ; ++index){
+			const std::string cache = root + "/cpu/cpu0/cache/index" + std::to_string(index);
+			const auto size = topology::detail::read_line(cache + "/size");
+			if (size.empty()) break;
+			size_t bytes = std::atol(size.c_str());
+			if (size.back() == 'K') bytes <<= 10;
+			if (size.back() == 'M') bytes <<= 20;
+			res = std::max(res, bytes);
+		}
+		return res;
+	}
+
+	inline double seconds_since(std::chrono::steady_clock::time_point start){
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+} // detail
+
+	template <typename Kernel>
+	inline double flops_per_point(){
+		if (detail::declared_flops<Kernel>::declared) return detail::declared_flops<Kernel>::value;
+		unsigned taps = 1;
+		for (unsigned d = 0; d < Kernel::dimensions; ++d) taps *= 2*Kernel::neighbours+1;
+		return 2.0*taps;
+	}
+
+	template <typename DataStorage, typename Kernel>
+	inline double bytes_per_point(const DataStorage& data, size_t cache = detail::last_level_cache()){
+		const double elem = sizeof(typename DataStorage::ElementType);
+		const unsigned reach = 2*Kernel::neighbours+1;
+		size_t plane = sizeof(typename DataStorage::ElementType);
+		for (unsigned d = 0; d+1 < DataStorage::dimensions; ++d) plane *= data.dimension_sizes[d];
+		const unsigned aux = getAuxiliaries(data);
+		const bool layers = DataStorage::dimensions == 1 || cache == 0 || (reach + aux)*plane*2 <= cache;
+		return elem * ((layers? 3: reach + 2) + aux);
+	}
+
+	/**
+	 * bandwidth (STREAM triad) and peak flops of this machine with the threads of the backend,
+	 * elements is the size of each of the three triad arrays
+	 */
+	inline Machine probe(size_t elements = 1<<22, unsigned repetitions = 5){
+
+		Machine m = {0, 0, detail::backend_threads()};
+		const int blocks = 8*m.threads;
+		const double scalar = 3.0;
+
+		std::unique_ptr<double[]> a (new double[elements]), b (new double[elements]), c (new double[elements]);
+		auto init = [&] (int blk){
+			for (size_t i = elements*blk/blocks; i < elements*(blk+1)/blocks; ++i) { a[i] = 0; b[i] = 1; c[i] = 2; }
+		};
+		P_FOR (blk, 0, blocks, 1, { init(blk); });
+
+		auto triad = [&] (int blk){
+			for (size_t i = elements*blk/blocks; i < elements*(blk+1)/blocks; ++i) a[i] = b[i] + scalar*c[i];
+		};
+		for (unsigned r = 0; r < repetitions; ++r){
+			const auto start = std::chrono::steady_clock::now();
+			P_FOR (blk, 0, blocks, 1, { triad(blk); });
+			m.bandwidth = std::max(m.bandwidth, 3*sizeof(double)*elements / detail::seconds_since(start));
+		}
+
+		// 16 independent chains hide the latency of the units
+		const long iterations = 1<<22;
+		std::vector<double> sink (m.threads, 0);
+		auto chains = [&] (int th){
+			double x[16];
+			for (int k = 0; k < 16; ++k) x[k] = 1.0 + k*1e-9;
+			const double mul = 0.999999999, add = 1e-9;
+			for (long i = 0; i < iterations; ++i){
+				for (int k = 0; k < 16; ++k) x[k] = x[k]*mul + add;
+			}
+			double s = 0;
+			for (int k = 0; k < 16; ++k) s += x[k];
+			sink[th] = s;
+		};
+		for (unsigned r = 0; r < 2; ++r){
+			const auto start = std::chrono::steady_clock::now();
+			P_FOR (th, 0, (int)m.threads, 1, { chains(th); });
+			m.flops = std::max(m.flops, 2.0*16*iterations*m.threads / detail::seconds_since(start));
+		}
+		volatile double keep = 0;		// the chains are not dead code
+		for (double s : sink) keep = keep + s;
+
+		return m;
+	}
+
+	// probed once per process
+	inline const Machine& machine(){
+		static const Machine m = probe();
+		return m;
+	}
+
+	/**
+	 * report of an engine which ran steps time steps on data in ms milliseconds
+	 */
+	template <typename DataStorage, typename Kernel>
+	Report report(const std::string& engine, double ms, const DataStorage& data, unsigned steps, const Machine& m = machine()){
+
+		Report r;
+		r.engine = engine;
+		r.ms = ms;
+		r.points = steps;
+		for (unsigned d = 0; d < DataStorage::dimensions; ++d) r.points *= data.dimension_sizes[d];
+
+		const double seconds = ms / 1e3;
+		r.pointsPerSecond = seconds > 0? r.points / seconds: 0;
+		r.bytesPerPoint = bytes_per_point<DataStorage, Kernel>(data);
+		r.flopsPerPoint = flops_per_point<Kernel>();
+		r.bandwidth = r.pointsPerSecond * r.bytesPerPoint;
+		r.flopRate = r.pointsPerSecond * r.flopsPerPoint;
+		r.intensity = r.flopsPerPoint / r.bytesPerPoint;
+		r.attainable = std::min(m.flops, r.intensity * m.bandwidth);
+		r.efficiency = r.attainable > 0? r.flopRate / r.attainable: 0;
+		r.bound = r.intensity * m.bandwidth < m.flops? "bandwidth": "compute";
+		return r;
+	}
+
+	// one JSON object per line
+	inline void print_json(std::ostream& os, const Report& r, const Machine& m = machine()){
+		os << "{\"engine\":\"" << r.engine << "\",\"ms\":" << r.ms << ",\"points\":" << r.points
+		   << ",\"points_per_s\":" << r.pointsPerSecond << ",\"bytes_per_point\":" << r.bytesPerPoint
+		   << ",\"flops_per_point\":" << r.flopsPerPoint << ",\"bandwidth\":" << r.bandwidth
+		   << ",\"flop_rate\":" << r.flopRate << ",\"intensity\":" << r.intensity
+		   << ",\"attainable\":" << r.attainable << ",\"efficiency\":" << r.efficiency
+		   << ",\"bound\":\"" << r.bound << "\",\"machine_bandwidth\":" << m.bandwidth
+		   << ",\"machine_flops\":" << m.flops << ",\"threads\":" << m.threads << "}" << std::endl;
+	}
+
+	inline void print_csv_header(std::ostream& os){
+		os << "engine,ms,points,points_per_s,bytes_per_point,flops_per_point,bandwidth,flop_rate,"
+		   << "intensity,attainable,efficiency,bound,machine_bandwidth,machine_flops,threads" << std::endl;
+	}
+
+	inline void print_csv(std::ostream& os, const Report& r, const Machine& m = machine()){
+		os << r.engine << "," << r.ms << "," << r.points << "," << r.pointsPerSecond << "," << r.bytesPerPoint << ","
+		   << r.flopsPerPoint << "," << r.bandwidth << "," << r.flopRate << "," << r.intensity << ","
+		   << r.attainable << "," << r.efficiency << "," << r.bound << "," << m.bandwidth << ","
+		   << m.flops << "," << m.threads << std::endl;
+	}
+
+} // roofline
+} // stencil namespace
@@ -89,6 +89,8 @@ namespace {
 
 		static std::map<thread::id, int> translation;
 		static int count = 0;
+		static std::mutex lock;
+		std::lock_guard<std::mutex> guard(lock);
 
 		if(translation.find(thid) == translation.end()){
 			translation[thid] = count++;
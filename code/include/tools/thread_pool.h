@@ -0,0 +1,292 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <condition_variable>
+
+#include "schedule.h"
+#include "tools/topology.h"
+
+
+namespace stencil{
+namespace detail {
+
+	/**
+	 * Persistent workers for parallel loops.
+	 * The calling thread takes part in the loop, the workers sleep in between loops.
+	 * Only one loop runs at a time: a loop started from inside a worker, or while another
+	 * loop is running, is executed serially by its caller.
+	 *
+	 * Workers are pinned following STENCIL_AFFINITY (see topology.h), the caller is not:
+	 * the threads it creates would inherit its mask. A worker which could not be pinned
+	 * shows -1 in getCpus() and is stolen from last. The dynamic schedule hands each
+	 * participant a contiguous range, who runs out steals half of the range of somebody
+	 * else, closest cpus first.
+	 */
+	class ForPool{
+
+		// [begin, end) packed in one word, the owner takes from the front, thieves from the back.
+		// Padded rather than aligned, new[] does not honour an extended alignment before C++17
+		struct Range{
+			std::atomic<unsigned long long> bounds;
+			char pad[64 - sizeof(std::atomic<unsigned long long>)];
+
+			static unsigned long long pack(int b, int e) { return ((unsigned long long)(unsigned)e << 32) | (unsigned)b; }
+			static int begin(unsigned long long r) { return (int)(r & 0xffffffff); }
+			static int end(unsigned long long r) { return (int)(r >> 32); }
+		};
+
+		struct Job{
+			const std::function<void(int)>* body;
+			int begin, step, iterations;
+			Schedule schedule;
+			int chunk;
+			unsigned participants;				// the first ones, up to the limit
+			std::atomic<int> next;
+			int pending;
+		};
+
+		std::vector<int> cpus;						// of each participant, -1 not pinned (or pinning failed)
+		std::vector<std::vector<unsigned>> victims;	// of each participant, closest first
+		std::unique_ptr<Range[]> ranges;
+
+		std::vector<std::thread> workers;
+		std::mutex lock;
+		std::condition_variable wake;
+		std::condition_variable done;
+		Job* job;
+		unsigned active;
+		unsigned long generation;
+		unsigned started;							// workers done pinning
+		bool stop;
+		std::atomic_flag busy;
+
+		static bool& inside(){
+			static thread_local bool flag = false;
+			return flag;
+		}
+
+		unsigned size() const{
+			return workers.size()+1;
+		}
+
+		// my part of the loop, id 0 is the caller
+		void work(Job& j, unsigned id){
+
+			const unsigned participants = j.participants;
+			if (id >= participants) return;
+
+			auto range = [&] (int first, int last){
+				for (int n = first; n < last; ++n) (*j.body)(j.begin + n*j.step);
+			};
+
+			switch (j.schedule){
+				case Schedule::Static:{
+					const int chunk = j.chunk > 0? j.chunk: (j.iterations + participants - 1) / participants;
+					for (int first = id*chunk; first < j.iterations; first += participants*chunk){
+						range(first, std::min(first + chunk, j.iterations));
+					}
+					break;
+				}
+				case Schedule::Dynamic:{
+					const int chunk = std::max(j.chunk, 1);
+					auto& mine = ranges[id].bounds;
+
+					while (true){
+						// my own range
+						auto r = mine.load();
+						while (Range::begin(r) < Range::end(r)){
+							const int first = Range::begin(r);
+							const int last = std::min(first + chunk, Range::end(r));
+							if (mine.compare_exchange_weak(r, Range::pack(last, Range::end(r)))){
+								range(first, last);
+								r = mine.load();
+							}
+						}
+
+						// steal half of somebody else's
+						bool stolen = false;
+						for (unsigned v : victims[id]){
+							if (v >= participants) continue;
+							auto& other = ranges[v].bounds;
+							auto o = other.load();
+							while (Range::begin(o) < Range::end(o)){
+								const int b = Range::begin(o);
+								const int e = Range::end(o);
+								const int mid = e - b > chunk? b + (e - b)/2: b;
+								if (other.compare_exchange_weak(o, Range::pack(b, mid))){
+									mine.store(Range::pack(mid, e));
+									stolen = true;
+									break;
+								}
+							}
+							if (stolen) break;
+						}
+						if (!stolen) break;
+					}
+					break;
+				}
+				case Schedule::Guided:{
+					const int chunk = std::max(j.chunk, 1);
+					int first = j.next.load();
+					while (first < j.iterations){
+						// chunks shrink with the remaining work, down to chunk
+						const int count = std::max((int)((j.iterations - first) / (2*participants)), chunk);
+						if (j.next.compare_exchange_weak(first, first + count)){
+							range(first, std::min(first + count, j.iterations));
+							first = j.next.load();
+						}
+					}
+					break;
+				}
+			}
+		}
+
+		void worker(unsigned id){
+
+			const bool pinned = cpus[id] >= 0 && topology::pin_thread(cpus[id]);
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if (!pinned) cpus[id] = -1;
+				started++;
+			}
+			done.notify_one();
+			inside() = true;
+			unsigned long seen = 0;
+
+			while (true){
+				Job* j;
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					wake.wait(guard, [&] () { return stop || generation != seen; });
+					if (stop) return;
+					seen = generation;
+					j = job;
+				}
+
+				work(*j, id);
+
+				std::lock_guard<std::mutex> guard(lock);
+				if (--j->pending == 0) done.notify_one();
+			}
+		}
+
+	public:
+
+		// a pool of its own, P_FOR uses instance()
+		explicit ForPool(unsigned threads, topology::Placement placement)
+		: cpus(threads, -1), victims(threads), ranges(new Range[threads]), job(nullptr), active(threads), generation(0), started(0), stop(false)
+		{
+			busy.clear();
+
+			const auto& machine = topology::Topology::get();
+			const auto where = machine.placement(placement, threads);
+			for (unsigned i = 1; i < where.size(); ++i) cpus[i] = where[i];
+
+			// the victims depend on where the workers did end up
+			for (unsigned i = 1; i < threads; ++i){
+				workers.emplace_back(&ForPool::worker, this, i);
+			}
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				done.wait(guard, [&] () { return started == threads-1; });
+			}
+
+			// victims sharing caches first, unpinned ones (the caller) at the end
+			for (unsigned i = 0; i < threads; ++i){
+				for (unsigned v = 0; v < threads; ++v) if (v != i) victims[i].push_back(v);
+				auto distance = [&] (unsigned v){
+					if (cpus[i] < 0 || cpus[v] < 0) return 7;
+					return machine.distance(cpus[i], cpus[v]);
+				};
+				std::stable_sort(victims[i].begin(), victims[i].end(), [&] (unsigned a, unsigned b){
+					return distance(a) < distance(b);
+				});
+			}
+		}
+
+		~ForPool(){
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stop = true;
+			}
+			wake.notify_all();
+			for (auto& w : workers) w.join();
+		}
+
+		static ForPool& instance(){
+			static ForPool pool (std::max(std::thread::hardware_concurrency(), 1u), topology::placement_from_env());
+			return pool;
+		}
+
+		unsigned getSize() const{
+			return size();
+		}
+
+		// loops from now on use the caller and the first n-1 workers, returns the new count.
+		// Call it between loops
+		unsigned limit(unsigned n){
+			active = std::max(1u, std::min(n, size()));
+			return active;
+		}
+
+		// cpu of each participant (0 is the caller), -1 if not pinned
+		const std::vector<int>& getCpus() const{
+			return cpus;
+		}
+
+		// calls body(i) for i in [begin, end) with stride step
+		void run(int begin, int end, int step, Schedule schedule, int chunk, const std::function<void(int)>& body){
+
+			const int iterations = end > begin? (end - begin + step - 1) / step: 0;
+			if (iterations == 0) return;
+
+			if (inside() || active == 1 || iterations == 1 || busy.test_and_set()){
+				for (int i = begin; i < end; i += step) body(i);
+				return;
+			}
+
+			Job j;
+			j.body = &body;
+			j.begin = begin;
+			j.step = step;
+			j.iterations = iterations;
+			j.schedule = schedule;
+			j.chunk = chunk;
+			j.participants = active;
+			j.next = 0;
+			j.pending = workers.size();
+
+			if (schedule == Schedule::Dynamic){
+				for (unsigned id = 0; id < active; ++id){
+					ranges[id].bounds = Range::pack(iterations * id / active, iterations * (id+1) / active);
+				}
+			}
+
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				job = &j;
+				generation++;
+			}
+			wake.notify_all();
+
+			inside() = true;
+			work(j, 0);
+			inside() = false;
+
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				done.wait(guard, [&] () { return j.pending == 0; });
+				job = nullptr;
+			}
+			busy.clear();
+		}
+	};
+
+} // detail
+} // stencil namespace
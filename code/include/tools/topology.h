@@ -0,0 +1,296 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+
+#ifdef __linux__
+#	include <sched.h>
+#	include <pthread.h>
+#endif
+
+
+namespace stencil{
+namespace topology{
+
+	/**
+	 * Where to put worker threads:
+	 *  None	 leave it to the OS
+	 *  Compact	 fill one cache domain after the other, SMT siblings together
+	 *  Cores	 like compact, but one thread per physical core before using SMT siblings
+	 *  Scatter	 round robin over the packages, one thread per core first
+	 */
+	enum class Placement { None, Compact, Cores, Scatter };
+
+	struct Cpu{
+		int id;
+		int core;				// physical core, unique in the machine
+		int package;
+		int node;				// NUMA node
+		int caches[4];			// cache domain of each level (lowest cpu sharing it), -1 unknown
+	};
+
+	// "0-3,8,10-11" -> {0,1,2,3,8,10,11}
+	inline std::vector<int> parse_cpu_list(const std::string& list){
+		std::vector<int> res;
+		std::stringstream ss(list);
+		std::string range;
+		while (std::getline(ss, range, ',')){
+			if (range.empty() || range[0] == '\n') continue;
+			const auto dash = range.find('-');
+			const int a = std::atoi(range.c_str());
+			const int b = dash == std::string::npos? a: std::atoi(range.c_str()+dash+1);
+			for (int i = a; i <= b; ++i) res.push_back(i);
+		}
+		return res;
+	}
+
+	/**
+	 * cpus this process may run on (taskset, cgroup cpusets, mpirun bindings), empty if unknown
+	 */
+	inline std::vector<int> allowed_cpus(){
+		std::vector<int> res;
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		if (sched_getaffinity(0, sizeof(set), &set) == 0){
+			for (int i = 0; i < CPU_SETSIZE; ++i) if (CPU_ISSET(i, &set)) res.push_back(i);
+		}
+#endif
+		return res;
+	}
+
+namespace detail {
+
+	inline std::string read_line(const std::string& path){
+		std::ifstream in (path);
+		std::string line;
+		if (in) std::getline(in, line);
+		return line;
+	}
+
+	inline int read_int(const std::string& path, int otherwise){
+		const auto line = read_line(path);
+		return line.empty()? otherwise: std::atoi(line.c_str());
+	}
+
+} // detail
+
+	/**
+	 * Cores, caches and NUMA nodes of the machine, read from sysfs.
+	 * Without sysfs every cpu is its own core in one package.
+	 * Only the allowed cpus are kept (all of them if none is), so placements never use a
+	 * cpu outside the affinity mask of the process.
+	 */
+	class Topology{
+
+		std::vector<Cpu> cpus;
+
+		template <typename T>
+		static int position(const std::vector<T>& v, const T& x){
+			return std::find(v.begin(), v.end(), x) - v.begin();
+		}
+
+		const Cpu& cpu(int id) const{
+			for (const auto& c : cpus) if (c.id == id) return c;
+			return cpus[0];
+		}
+
+		void discover(const std::string& root, const std::vector<int>& allowed){
+
+			auto online = parse_cpu_list(detail::read_line(root + "/cpu/online"));
+			if (online.empty()){
+				online = allowed;
+				const int n = std::max(std::thread::hardware_concurrency(), 1u);
+				for (int i = 0; online.empty() && i < n; ++i) online.push_back(i);
+				for (int i : online) cpus.push_back(Cpu{i, i, 0, 0, {-1, -1, -1, -1}});
+				return;
+			}
+
+			std::vector<int> usable;
+			for (int id : online) if (position(allowed, id) < (int)allowed.size()) usable.push_back(id);
+			if (!usable.empty()) online.swap(usable);
+
+			std::vector<std::vector<int>> nodes;
+			for (int n = 0; ; ++n){
+				const auto list = detail::read_line(root + "/node/node" + std::to_string(n) + "/cpulist");
+				if (list.empty()) break;
+				nodes.push_back(parse_cpu_list(list));
+			}
+
+			std::vector<std::pair<int, int>> cores;		// (package, core_id) -> core
+			for (int id : online){
+				const std::string dir = root + "/cpu/cpu" + std::to_string(id);
+				Cpu c = {id, 0, detail::read_int(dir + "/topology/physical_package_id", 0), 0, {-1, -1, -1, -1}};
+
+				const auto key = std::make_pair(c.package, detail::read_int(dir + "/topology/core_id", id));
+				c.core = position(cores, key);
+				if (c.core == (int)cores.size()) cores.push_back(key);
+
+				for (unsigned n = 0; n < nodes.size(); ++n){
+					if (position(nodes[n], id) < (int)nodes[n].size()) c.node = n;
+				}
+
+				for (int index = 0; ; ++index){
+					const std::string cache = dir + "/cache/index" + std::to_string(index);
+					const int level = detail::read_int(cache + "/level", -1);
+					if (level < 0) break;
+					if (level > 3 || detail::read_line(cache + "/type") == "Instruction") continue;
+					const auto shared = parse_cpu_list(detail::read_line(cache + "/shared_cpu_list"));
+					c.caches[level] = shared.empty()? id: *std::min_element(shared.begin(), shared.end());
+				}
+				cpus.push_back(c);
+			}
+		}
+
+		// locality order: node, package, last level cache, L2, core
+		std::vector<Cpu> compact() const{
+			auto res = cpus;
+			std::sort(res.begin(), res.end(), [] (const Cpu& a, const Cpu& b){
+				if (a.node != b.node) return a.node < b.node;
+				if (a.package != b.package) return a.package < b.package;
+				if (a.caches[3] != b.caches[3]) return a.caches[3] < b.caches[3];
+				if (a.caches[2] != b.caches[2]) return a.caches[2] < b.caches[2];
+				if (a.core != b.core) return a.core < b.core;
+				return a.id < b.id;
+			});
+			return res;
+		}
+
+		// first cpu of every core, then the second ones...
+		std::vector<Cpu> one_per_core() const{
+			std::vector<Cpu> res;
+			std::vector<int> used;
+			auto order = compact();
+			while (!order.empty()){
+				std::vector<Cpu> rest;
+				used.clear();
+				for (const auto& c : order){
+					if (position(used, c.core) < (int)used.size()) rest.push_back(c);
+					else { res.push_back(c); used.push_back(c.core); }
+				}
+				order.swap(rest);
+			}
+			return res;
+		}
+
+	public:
+
+		explicit Topology(const std::string& root = "/sys/devices/system", const std::vector<int>& allowed = {}){
+			discover(root, allowed);
+		}
+
+		// the cpus this process may use, the mask is read once
+		static const Topology& get(){
+			static Topology machine ("/sys/devices/system", allowed_cpus());
+			return machine;
+		}
+
+		const std::vector<Cpu>& getCpus() const{
+			return cpus;
+		}
+
+		/**
+		 * how far two cpus are: 0 same cpu, 1 SMT siblings, 2 share L2, 3 share the last
+		 * level cache, 4 same NUMA node, 5 same package, 6 anything else
+		 */
+		int distance(int a, int b) const{
+			if (a == b) return 0;
+			const auto& x = cpu(a);
+			const auto& y = cpu(b);
+			if (x.core == y.core) return 1;
+			if (x.caches[2] >= 0 && x.caches[2] == y.caches[2]) return 2;
+			if (x.caches[3] >= 0 && x.caches[3] == y.caches[3]) return 3;
+			if (x.node == y.node) return 4;
+			if (x.package == y.package) return 5;
+			return 6;
+		}
+
+		/**
+		 * cpu for each of n threads, empty for Placement::None.
+		 * With more threads than cpus the list wraps around
+		 */
+		std::vector<int> placement(Placement policy, unsigned n) const{
+
+			std::vector<Cpu> order;
+			switch (policy){
+				case Placement::None:
+					return {};
+				case Placement::Compact:
+					order = compact();
+					break;
+				case Placement::Cores:
+					order = one_per_core();
+					break;
+				case Placement::Scatter:{
+					// one core per package in turn
+					std::vector<std::vector<Cpu>> packages;
+					std::vector<int> ids;
+					for (const auto& c : one_per_core()){
+						const int p = position(ids, c.package);
+						if (p == (int)ids.size()) { ids.push_back(c.package); packages.emplace_back(); }
+						packages[p].push_back(c);
+					}
+					for (unsigned i = 0; order.size() < cpus.size(); ++i){
+						for (const auto& p : packages) if (i < p.size()) order.push_back(p[i]);
+					}
+					break;
+				}
+			}
+
+			std::vector<int> res;
+			for (unsigned i = 0; i < n; ++i) res.push_back(order[i % order.size()].id);
+			return res;
+		}
+	};
+
+	/**
+	 * placement requested with STENCIL_AFFINITY=none|compact|cores|scatter, none by default
+	 */
+	inline Placement placement_from_env(){
+		const char* env = std::getenv("STENCIL_AFFINITY");
+		const std::string policy = env? env: "";
+		if (policy == "compact") return Placement::Compact;
+		if (policy == "cores")   return Placement::Cores;
+		if (policy == "scatter") return Placement::Scatter;
+		return Placement::None;
+	}
+
+	// cpu for a position in [0,1): the order (of a placement) stretched over [0,1), -1 if empty
+	inline int home_cpu(double position, const std::vector<int>& order){
+		if (order.empty()) return -1;
+		const int i = position * order.size();
+		return order[std::min(std::max(i, 0), (int)order.size()-1)];
+	}
+
+	/**
+	 * cpu for a position in [0,1) of the domain: the placement order of STENCIL_AFFINITY
+	 * stretched over the domain, so close positions get cpus which share caches (unless
+	 * the policy is scatter). -1 without placement policy. Only allowed cpus are returned,
+	 * as the order comes from Topology::get()
+	 */
+	inline int home_cpu(double position){
+		static const auto order = Topology::get().placement(placement_from_env(), Topology::get().getCpus().size());
+		return home_cpu(position, order);
+	}
+
+	/**
+	 * pins the calling thread to a cpu, threads created afterwards by this one inherit it
+	 */
+	inline bool pin_thread(int cpu){
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+		return false;
+#endif
+	}
+
+} // topology
+} // stencil namespace
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#	include <x86intrin.h>
+#endif
+
+#ifndef TRACE_BUFFER
+#  define TRACE_BUFFER (1<<16)
+#endif
+
+// counter values a record can carry (see perf_counters.h)
+#ifndef TRACE_COUNTERS
+#  define TRACE_COUNTERS 4
+#endif
+
+
+namespace stencil{
+namespace trace{
+
+	/**
+	 * Low overhead tracing: each thread writes fixed size records in its own ring buffer,
+	 * no locks on the hot path. Event names are interned once per call site.
+	 * The buffers are merged with collect, and at exit into times.sw and trace.json when built
+	 * with INSTRUMENT or PERF_COUNTERS (tests using the tracer leave no files), the latter in Chrome trace event format (chrome://tracing, Perfetto), one track per buffer.
+	 * Rings start small and double up to TRACE_BUFFER records, a full ring keeps the latest
+	 * ones. When a thread exits its buffer goes back to the registry and the next new thread
+	 * takes it, so there are as many buffers (and tracks) as threads alive at once. With
+	 * CXX_ASYNC, where every spawn is a thread of its own, a track is such a slot, not a worker.
+	 */
+	struct Record{
+		uint64_t start;		// ticks
+		uint64_t end;
+		uint32_t event;		// interned name
+		uint32_t thread;	// in order of first record
+		int32_t  t0, t1;	// time steps
+		int32_t  arg;		// free, loop index for loops
+		uint16_t dims;
+		uint16_t shape;		// bit d set if the zoid is B (wider top) in dimension d
+		uint32_t task;		// spawned task it belongs to, 0 the initial one
+		uint64_t volume;	// points computed
+		uint32_t ncounters;
+		uint64_t counters[TRACE_COUNTERS];
+	};
+
+	// cheapest clock around: TSC on x86, steady_clock nanoseconds otherwise
+	inline uint64_t ticks(){
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+namespace detail {
+
+	inline uint32_t& current_task(){
+		static thread_local uint32_t task = 0;
+		return task;
+	}
+
+	inline std::string shape_name(const Record& r){
+		std::string shape;
+		for (unsigned d = 0; d < r.dims; ++d) shape += (r.shape & (1<<d))? 'B': 'A';
+		return shape.empty()? "-": shape;
+	}
+
+	struct Buffer{
+		std::vector<Record> records;		// grows up to TRACE_BUFFER, a ring from then on
+		std::atomic<uint64_t> head;		// records ever written, only the owner writes
+		uint32_t thread;
+
+		Buffer(uint32_t id)
+		: records(std::min(256, TRACE_BUFFER)), head(0), thread(id) {}
+
+		// where the record number n goes
+		Record& at(uint64_t n){
+			if (n >= records.size() && n < TRACE_BUFFER) records.resize(std::min<size_t>(2*records.size(), TRACE_BUFFER));
+			return records[n % TRACE_BUFFER];
+		}
+	};
+
+	// the buffer of a thread, given back to the registry when the thread exits
+	struct Owner{
+		Buffer* buffer;
+
+		Owner() : buffer(nullptr) {}
+		~Owner();
+	};
+
+	class Registry{
+
+		std::mutex lock;
+		std::vector<std::string> names;
+		std::vector<std::string> counters;
+		std::vector<std::unique_ptr<Buffer>> buffers;
+		std::vector<Buffer*> idle;		// of threads which exited
+
+		// pairs of (ticks, steady clock) to convert ticks into microseconds
+		uint64_t tick0;
+		std::chrono::steady_clock::time_point clock0;
+
+	public:
+
+		Registry()
+		: tick0(ticks()), clock0(std::chrono::steady_clock::now()) {}
+
+		~Registry(){
+#if defined(INSTRUMENT) || defined(PERF_COUNTERS)
+			const auto records = collect();
+			if (records.empty()) return;
+			std::ofstream out ("times.sw");
+			dump(out, records);
+			std::ofstream json ("trace.json");
+			chrome_trace(json, records);
+#endif
+		}
+
+		static Registry& instance(){
+			static Registry registry;
+			return registry;
+		}
+
+		uint32_t intern(const std::string& name){
+			std::lock_guard<std::mutex> guard(lock);
+			auto it = std::find(names.begin(), names.end(), name);
+			if (it != names.end()) return it - names.begin();
+			names.push_back(name);
+			return names.size()-1;
+		}
+
+		void counter_names(const std::vector<std::string>& names){
+			std::lock_guard<std::mutex> guard(lock);
+			counters = names;
+		}
+
+		const std::string& name(uint32_t event){
+			std::lock_guard<std::mutex> guard(lock);
+			return names[event];
+		}
+
+		// buffers outlive their threads, they are merged at the end
+		Buffer& mine(){
+			static thread_local Owner owner;
+			if (!owner.buffer){
+				std::lock_guard<std::mutex> guard(lock);
+				if (idle.empty()){
+					buffers.emplace_back(new Buffer(buffers.size()));
+					idle.push_back(buffers.back().get());
+				}
+				owner.buffer = idle.back();
+				idle.pop_back();
+			}
+			return *owner.buffer;
+		}
+
+		void release(Buffer* buffer){
+			std::lock_guard<std::mutex> guard(lock);
+			idle.push_back(buffer);
+		}
+
+		size_t buffer_count(){
+			std::lock_guard<std::mutex> guard(lock);
+			return buffers.size();
+		}
+
+		// all records sorted by start, call it when no thread is tracing
+		std::vector<Record> collect(){
+			std::lock_guard<std::mutex> guard(lock);
+			std::vector<Record> res;
+			for (const auto& b : buffers){
+				const uint64_t head = b->head.load(std::memory_order_acquire);
+				const uint64_t first = head > TRACE_BUFFER? head - TRACE_BUFFER: 0;
+				for (uint64_t i = first; i < head; ++i) res.push_back(b->records[i % TRACE_BUFFER]);
+			}
+			std::sort(res.begin(), res.end(), [] (const Record& a, const Record& b) { return a.start < b.start; });
+			return res;
+		}
+
+		void clear(){
+			std::lock_guard<std::mutex> guard(lock);
+			for (auto& b : buffers) b->head.store(0, std::memory_order_release);
+		}
+
+		// microseconds since the registry was created
+		double microseconds(uint64_t t){
+			const double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - clock0).count();
+			const uint64_t ticksNow = ticks();
+			const double perTick = ticksNow > tick0? elapsed / (ticksNow - tick0): 0;
+			return t > tick0? (t - tick0) * perTick: 0;
+		}
+
+		void dump(std::ostream& os, const std::vector<Record>& records){
+			os << "pid\tstart\tend\tkind\tshape\tt0\tt1\targ" << std::endl;
+			for (const auto& r : records){
+				os << r.thread << "\t" << std::fixed << std::setprecision(2) << microseconds(r.start)
+							   << "\t" << std::fixed << std::setprecision(2) << microseconds(r.end)
+							   << "\t" << name(r.event) << "\t" << shape_name(r)
+							   << "\t" << r.t0 << "\t" << r.t1 << "\t" << r.arg << std::endl;
+			}
+		}
+
+		// complete ("X") events, pid 0 and one tid per thread
+		void chrome_trace(std::ostream& os, const std::vector<Record>& records){
+			uint32_t threads = 0;
+			for (const auto& r : records) threads = std::max(threads, r.thread+1);
+
+			os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << std::endl;
+			os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"stencil\"}}";
+			for (uint32_t t = 0; t < threads; ++t){
+				os << "," << std::endl << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << t
+				   << ",\"args\":{\"name\":\"thread " << t << "\"}}";
+			}
+			for (const auto& r : records){
+				const double start = microseconds(r.start);
+				const double end = microseconds(r.end);
+				os << "," << std::endl << std::fixed << std::setprecision(3)
+				   << "{\"name\":\"" << name(r.event) << "\",\"cat\":\"stencil\",\"ph\":\"X\",\"pid\":0,\"tid\":" << r.thread
+				   << ",\"ts\":" << start << ",\"dur\":" << std::max(end - start, 0.0)
+				   << ",\"args\":{\"shape\":\"" << shape_name(r) << "\",\"t0\":" << r.t0 << ",\"t1\":" << r.t1
+				   << ",\"volume\":" << r.volume << ",\"arg\":" << r.arg
+				   << ",\"task\":" << r.task << ",\"spawned\":" << (r.task? "true": "false");
+				for (unsigned i = 0; i < r.ncounters && i < counters.size(); ++i){
+					os << ",\"" << counters[i] << "\":" << r.counters[i];
+				}
+				os << "}}";
+			}
+			os << std::endl << "]}" << std::endl;
+		}
+	};
+
+	inline Owner::~Owner(){
+		if (buffer) Registry::instance().release(buffer);
+	}
+
+} // detail
+
+	// id of an event name, intern once per call site (static local)
+	inline uint32_t intern(const std::string& name){
+		return detail::Registry::instance().intern(name);
+	}
+
+	inline void record(const Record& r){
+		auto& b = detail::Registry::instance().mine();
+		const uint64_t head = b.head.load(std::memory_order_relaxed);
+		Record& slot = b.at(head);
+		slot = r;
+		slot.thread = b.thread;
+		b.head.store(head + 1, std::memory_order_release);
+	}
+
+	// names of the counters carried by the records
+	inline void counter_names(const std::vector<std::string>& names){
+		detail::Registry::instance().counter_names(names);
+	}
+
+	inline std::vector<Record> collect(){
+		return detail::Registry::instance().collect();
+	}
+
+	inline void clear(){
+		detail::Registry::instance().clear();
+	}
+
+	// buffers allocated so far, at most the threads ever alive at once
+	inline size_t buffers(){
+		return detail::Registry::instance().buffer_count();
+	}
+
+	inline void dump(std::ostream& os){
+		auto& registry = detail::Registry::instance();
+		registry.dump(os, registry.collect());
+	}
+
+	inline void chrome_trace(std::ostream& os){
+		auto& registry = detail::Registry::instance();
+		registry.chrome_trace(os, registry.collect());
+	}
+
+	/**
+	 * an event from construction to end() or destruction
+	 */
+	class Scope{
+		Record r;
+		bool finished;
+	public:
+
+		Scope(uint32_t event, int t0, int t1, int arg = 0, unsigned dims = 0, unsigned shape = 0, uint64_t volume = 0)
+		: r(), finished(false) {
+			r.event = event;
+			r.t0 = t0;
+			r.t1 = t1;
+			r.arg = arg;
+			r.dims = dims;
+			r.shape = shape;
+			r.task = detail::current_task();
+			r.volume = volume;
+			r.start = ticks();
+		}
+
+		Scope(const Scope&) = delete;
+
+		Scope(Scope&& o)
+		: r(o.r), finished(o.finished) {
+			o.finished = true;
+		}
+
+		void end(){
+			if (finished) return;
+			r.end = ticks();
+			record(r);
+			finished = true;
+		}
+
+		~Scope(){
+			end();
+		}
+	};
+
+	/**
+	 * a spawned task, the events recorded by this thread meanwhile belong to it
+	 */
+	class Task{
+		uint32_t parent;
+		Scope scope;
+
+		static uint32_t next(){
+			static std::atomic<uint32_t> count (0);
+			return ++count;
+		}
+
+		// interned once, spawns do not take the lock of the registry
+		static uint32_t event(){
+			static const uint32_t id = intern("task");
+			return id;
+		}
+	public:
+
+		Task()
+		: parent(detail::current_task()), scope((detail::current_task() = next(), event()), 0, 0) {}
+
+		~Task(){
+			scope.end();
+			detail::current_task() = parent;
+		}
+	};
+
+	// A/B pattern of a zoid
+	template <typename Zoid>
+	inline unsigned shape(const Zoid& z){
+		unsigned res = 0;
+		for (unsigned d = 0; d < Zoid::dimensions; ++d) if (z.da(d) < z.db(d)) res |= 1u << d;
+		return res;
+	}
+
+	// points of a zoid in [t0, t1)
+	template <typename Zoid>
+	inline uint64_t volume(const Zoid& z, int t0, int t1){
+		uint64_t res = 0;
+		for (int s = 0; s < t1 - t0; ++s){
+			uint64_t slice = 1;
+			for (unsigned d = 0; d < Zoid::dimensions; ++d) slice *= std::max(z.b(d) - z.a(d) + s*(z.db(d) - z.da(d)), 0);
+			res += slice;
+		}
+		return res;
+	}
+
+} // trace
+} // stencil namespace
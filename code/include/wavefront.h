@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cassert>
+
+#include "kernel.h"
+#include "bufferSet.h"
+#include "dispatch.h"
+
+
+namespace stencil{
+
+	/**
+	 * Loop based temporal tiling, a static alternative to the recursion.
+	 * Time is cut in bands of height steps, the last dimension is cut in tiles of width points.
+	 * In each band, first all the A tiles (trapezoids shrinking by the kernel slope) run in
+	 * parallel, then all the B tiles (inverted trapezoids filling the gaps between them):
+	 * two wavefronts per band, each one as parallel as there are tiles.
+	 * The other dimensions are traversed whole, dimension 0 rows are never cut.
+	 */
+
+namespace detail {
+
+	#define FOR_DIMENSION(N) \
+	template <typename DataStorage, typename Kernel> \
+			inline typename std::enable_if< is_eq<Kernel::dimensions, N>::value, void>::type
+
+		// all points whose last coordinate is in [a, b) at time t
+		FOR_DIMENSION(1) wavefront_slab (DataStorage& data, int a, int b, int t){
+			solve_row<Kernel>(data, a, b, t);
+		}
+
+		FOR_DIMENSION(2) wavefront_slab (DataStorage& data, int a, int b, int t){
+			const int W = getW(data);
+			for (int j = a; j < b; ++j){
+				solve_row<Kernel>(data, 0, W, j, t);
+			}
+		}
+
+		FOR_DIMENSION(3) wavefront_slab (DataStorage& data, int a, int b, int t){
+			const int W = getW(data);
+			const int H = getH(data);
+			for (int k = a; k < b; ++k){
+				for (int j = 0; j < H; ++j){
+					solve_row<Kernel>(data, 0, W, j, k, t);
+				}
+			}
+		}
+
+		FOR_DIMENSION(4) wavefront_slab (DataStorage& data, int a, int b, int t){
+			const int W = getW(data);
+			const int H = getH(data);
+			const int D = getD(data);
+			for (int w = a; w < b; ++w){
+				for (int k = 0; k < D; ++k){
+					for (int j = 0; j < H; ++j){
+						solve_row<Kernel>(data, 0, W, j, k, w, t);
+					}
+				}
+			}
+		}
+
+	#undef FOR_DIMENSION
+
+	// one tile: [a, b) at the first step, the sides move da and db each step
+	template <typename DataStorage, typename Kernel>
+	inline void wavefront_tile (DataStorage& data, int a, int b, int da, int db, int t0, int t1){
+		for (int t = t0; t < t1; ++t){
+			wavefront_slab<DataStorage, Kernel>(data, a, b, t);
+			a += da;
+			b += db;
+		}
+	}
+
+	// runs the time steps [t0, t1)
+	template <typename DataStorage, typename Kernel>
+	void wavefront_range(DataStorage& data, int t0, int t1, int width, int height){
+
+		const int n = Kernel::neighbours;
+		const int last = DataStorage::dimensions-1;
+		const int size = data.dimension_sizes[last];
+
+		assert(height > 0);
+		// A tiles shrink from both sides during the whole band
+		width = MAX(width, 2*n*height);
+		// the remainder goes to the last tile, so no tile is narrower than width
+		const int tiles = MAX(size / width, 1);
+
+		for (int t = t0; t < t1; t += height){
+
+			const int t2 = MIN(t + height, t1);
+
+			auto tileA = [&] (int c){
+				const int a = c*width;
+				const int b = c == tiles-1? size: a + width;
+				wavefront_tile<DataStorage, Kernel>(data, a, b, a == 0? 0: n, b == size? 0: -n, t, t2);
+			};
+			auto tileB = [&] (int c){
+				const int x = c*width;
+				wavefront_tile<DataStorage, Kernel>(data, x, x, -n, n, t, t2);
+			};
+
+			P_FOR (c, 0, tiles, 1, { tileA(c); });
+			P_FOR (c, 1, tiles, 1, { tileB(c); });
+		}
+
+		data.setTime(t1);
+	}
+
+} // detail
+
+	/**
+	 * Runs t time steps from copy 0. width is the tile size along the last dimension (it is
+	 * raised to 2*neighbours*height if smaller), height the time steps per band
+	 */
+	template <typename DataStorage, typename Kernel>
+	void wavefront_stencil(DataStorage& data, unsigned t, int width, int height){
+		detail::wavefront_range<DataStorage, Kernel>(data, 0, t, width, height);
+	}
+
+} // stencil namespace
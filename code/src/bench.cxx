@@ -0,0 +1,376 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <string>
+#include <thread>
+
+#include "hyperspace.h"
+#include "kernel.h"
+#include "kernels_1D.h"
+#include "kernels_2D.h"
+#include "kernels_3D.h"
+#include "bufferSet.h"
+
+#include "new_rec_stencil.h"
+#include "overlapped_tiling.h"
+#include "wavefront.h"
+#include "iterative_stencil.h"
+
+#include "timer.h"
+
+using namespace stencil;
+
+/**
+ * Benchmark harness: every combination of kernel, size, time steps, threads and engine
+ * is run warmup times and then repetitions times, each run on the same buffer reset to the
+ * same input (see time_repetitions in timer.h). Every copy of the buffer is touched before
+ * timing, so no run pays first touch page faults. Results are printed as a table, written as JSON (-o) and appended to logs (-l)
+ * in the format of the measures/ logs, one line per repetition:
+ *     kind;alg;size;timesteps;\tcores;\tms
+ * where kind is the backend this binary was compiled for. That format has no kernel column,
+ * so there is one log per kernel: -l bench.log writes bench-jacobi2d.log, bench-heat3d.log...
+ */
+
+// #######################################################################################
+
+#if defined(_OPENMP)
+	const char* KIND = "omp";
+#elif defined(CILK)
+	const char* KIND = "cilk";
+#elif defined(CXX_ASYNC)
+	const char* KIND = "cxx";
+#elif defined(INSIEME_RT)
+	const char* KIND = "insiemert";
+#elif defined(PROFILE_PARALLELISM)
+	const char* KIND = "profile";
+#else
+	const char* KIND = "seq";
+#endif
+
+const std::vector<std::string> KERNELS = { "avg1d", "jacobi2d", "blur3", "gauss9", "heat3d", "avg3d", "star13", "star25", "box27" };
+const std::vector<std::string> ENGINES = { "rec", "it", "tiled", "ovl", "wave" };
+
+// the kernel template of bench takes the storage only
+template <typename DataStorage>
+using Gauss9_k = example_kernels::BlurN_k<DataStorage, 9>;
+
+std::vector<std::string> kernels, engines;
+std::vector<unsigned> dims, threads, steps;
+std::vector<size_t> sizes;
+unsigned warmup = 1;
+unsigned repetitions = 5;
+unsigned tileSteps = 8;		// time steps per tile, ovl and wave
+bool VALIDATE = true;
+bool RUSAGE = false;
+std::string JSON, LOG;
+
+struct Result{
+	std::string kernel;
+	unsigned dims;
+	size_t size;
+	unsigned steps;
+	std::string engine;
+	unsigned threads;
+	double points;			// updates, points * time steps
+	Timing timing;
+	bool valid;
+};
+
+std::vector<Result> results;
+
+// #######################################################################################
+
+void help(){
+	std::cout << "Stencil benchmark:" << std::endl;
+	std::cout << "StencilBench [-k kernels] [-d dimensions] [-s sizes] [-t time steps] [-e engines] [-p threads]" << std::endl;
+	std::cout << "             [-w warmup runs] [-n repetitions] [-b time steps per tile] [-x no validation]" << std::endl;
+	std::cout << "             [-u page faults and context switches per run]" << std::endl;
+	std::cout << "             [-o results.json] [-l measures.log, one per kernel: measures-<kernel>.log]" << std::endl;
+	std::cout << " lists are comma separated" << std::endl;
+	std::cout << " kernels:";
+	for (const auto& k : KERNELS) std::cout << " " << k;
+	std::cout << std::endl << " engines:";
+	for (const auto& e : ENGINES) std::cout << " " << e;
+	std::cout << std::endl << " sizes are per dimension, by default 1000000 (1D), 1000 (2D) and 100 (3D)" << std::endl;
+}
+
+std::vector<std::string> split(const std::string& list){
+	std::vector<std::string> res;
+	std::stringstream ss (list);
+	std::string item;
+	while (std::getline(ss, item, ',')) if (!item.empty()) res.push_back(item);
+	return res;
+}
+
+template <typename T>
+std::vector<T> numbers(const std::string& list){
+	std::vector<T> res;
+	for (const auto& item : split(list)) res.push_back(std::atol(item.c_str()));
+	return res;
+}
+
+void parse_args(int argc, char *argv[]){
+
+	int i = 1;
+	while(i < argc){
+
+		std::string param(argv[i]);
+		const bool value = i+1 < argc;
+		if (param == "-k" && value){
+			kernels = split(argv[++i]);
+		}
+		else if (param == "-d" && value){
+			dims = numbers<unsigned>(argv[++i]);
+		}
+		else if (param == "-s" && value){
+			sizes = numbers<size_t>(argv[++i]);
+		}
+		else if (param == "-t" && value){
+			steps = numbers<unsigned>(argv[++i]);
+		}
+		else if (param == "-e" && value){
+			engines = split(argv[++i]);
+		}
+		else if (param == "-p" && value){
+			threads = numbers<unsigned>(argv[++i]);
+		}
+		else if (param == "-w" && value){
+			warmup = std::atoi(argv[++i]);
+		}
+		else if (param == "-n" && value){
+			repetitions = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (param == "-b" && value){
+			tileSteps = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (param == "-x"){
+			VALIDATE = false;
+		}
+		else if (param == "-u"){
+			RUSAGE = true;
+		}
+		else if (param == "-o" && value){
+			JSON = argv[++i];
+		}
+		else if (param == "-l" && value){
+			LOG = argv[++i];
+		}
+		else {
+
+			help();
+			exit(param == "-h"? 0: 1);
+		}
+
+		i++;
+	}
+
+	if (kernels.empty()) kernels = KERNELS;
+	if (engines.empty()) engines = ENGINES;
+	if (steps.empty()) steps = { 50 };
+	if (threads.empty()) threads = { std::max(std::thread::hardware_concurrency(), 1u) };
+
+	for (const auto& k : kernels){
+		if (std::find(KERNELS.begin(), KERNELS.end(), k) == KERNELS.end()) { std::cout << "unknown kernel " << k << std::endl; exit(1); }
+	}
+	for (const auto& e : engines){
+		if (std::find(ENGINES.begin(), ENGINES.end(), e) == ENGINES.end()) { std::cout << "unknown engine " << e << std::endl; exit(1); }
+	}
+}
+
+//######################## ENGINES ################################################
+
+template <typename DataStorage, typename Kernel>
+void run_engine(const std::string& engine, DataStorage& data, unsigned t){
+
+	const unsigned D = DataStorage::dimensions;
+	std::array<int, D> block;
+
+	if (engine == "rec"){
+		recursive_stencil<DataStorage, Kernel>(data, t);
+	}
+	else if (engine == "it"){
+		// a sweep per time step, one loop iteration per row (2D) or plane (3D)
+		for (unsigned d = 0; d < D; ++d) block[d] = data.dimension_sizes[d];
+		block[D-1] = D == 1? MAX((int)data.dimension_sizes[0] / 64, 1): 1;
+		iterative_stencil<DataStorage, Kernel>(data, t, block);
+	}
+	else if (engine == "tiled"){
+		const int tiles[] = { (int)data.dimension_sizes[0], 16, 8 };
+		for (unsigned d = 0; d < D; ++d) block[d] = MIN(tiles[d % 3], (int)data.dimension_sizes[d]);
+		if (D == 1) block[0] = MIN(4096, (int)data.dimension_sizes[0]);
+		iterative_stencil<DataStorage, Kernel>(data, t, block);
+	}
+	else if (engine == "ovl"){
+		for (unsigned d = 0; d < D; ++d) block[d] = MAX((int)data.dimension_sizes[d] / 4, 1);
+		overlapped_stencil<DataStorage, Kernel>(data, t, block, tileSteps);
+	}
+	else if (engine == "wave"){
+		wavefront_stencil<DataStorage, Kernel>(data, t, MAX((int)data.dimension_sizes[D-1] / 8, 1), tileSteps);
+	}
+}
+
+template <typename DataStorage>
+bool same(const DataStorage& a, const DataStorage& b, size_t elements){
+	auto* x = const_cast<DataStorage&>(a).getCurrentPointer();
+	auto* y = const_cast<DataStorage&>(b).getCurrentPointer();
+	return std::equal(x, x + elements, y);
+}
+
+template <typename Elem, unsigned Dimensions, template <typename> class KernelTemplate>
+void bench(const std::string& name, size_t size){
+
+	typedef BufferSet<Elem, Dimensions> DataStorage;
+	typedef KernelTemplate<DataStorage> Kernel;
+
+	std::array<size_t, Dimensions> extent;
+	size_t elements = 1;
+	for (unsigned d = 0; d < Dimensions; ++d) { extent[d] = size; elements *= size; }
+
+	std::mt19937 generator (42);
+	std::uniform_real_distribution<double> uniform (0.0, 1.0);
+	std::vector<Elem> input (elements);
+	for (auto& e : input) e = uniform(generator);
+
+	for (unsigned t : steps){
+
+		std::unique_ptr<DataStorage> reference;
+		if (VALIDATE){
+			reference.reset(new DataStorage(extent, input));
+			recursive_stencil<DataStorage, Kernel>(*reference, t);
+		}
+
+		for (unsigned p : threads){
+
+			const unsigned used = set_threads(p);
+			if (used != p) std::cout << " " << KIND << " runs with " << used << " threads, not " << p << std::endl;
+
+			for (const auto& engine : engines){
+
+				Result r = { name, Dimensions, size, t, engine, used, (double)elements * t, Timing(), true };
+				std::unique_ptr<DataStorage> data (new DataStorage(extent, input));
+				for (unsigned c = 1; c < DataStorage::copies; ++c) std::copy(input.begin(), input.end(), data->getPointer(c));
+
+				auto reset = [&] () {
+					std::copy(input.begin(), input.end(), data->getPointer(0));
+					data->setTime(0);
+				};
+				r.timing = time_repetitions(TimingConfig(warmup, repetitions, 3.0, RUSAGE), reset,
+											[&] () { run_engine<DataStorage, Kernel>(engine, *data, t); });
+				if (reference) r.valid = same(*data, *reference, elements);
+
+				const Timing& s = r.timing;
+				std::cout << std::left << std::setw(10) << name << std::setw(3) << Dimensions << std::right
+						  << std::setw(9) << size << std::setw(7) << t << "  " << std::left << std::setw(7) << engine << std::right
+						  << std::setw(5) << used << std::fixed << std::setprecision(3)
+						  << std::setw(12) << s.median << std::setw(12) << s.min << std::setw(12) << s.max << std::setw(10) << s.mad
+						  << std::setw(12) << std::setprecision(2) << (s.median > 0? r.points / s.median / 1e3: 0)
+						  << (r.valid? "": "  VALIDATION FAILED") << std::endl;
+				results.push_back(r);
+			}
+		}
+	}
+}
+
+// #######################################################################################
+
+void write_json(std::ostream& os){
+	os << "[" << std::endl;
+	for (unsigned i = 0; i < results.size(); ++i){
+		const auto& r = results[i];
+		const Timing& s = r.timing;
+		os << std::setprecision(6)
+		   << "{\"kind\":\"" << KIND << "\",\"alg\":\"" << r.engine << "\",\"size\":" << r.size << ",\"timesteps\":" << r.steps
+		   << ",\"cores\":" << r.threads << ",\"ms\":" << s.median
+		   << ",\"kernel\":\"" << r.kernel << "\",\"dimensions\":" << r.dims
+		   << ",\"warmup\":" << warmup << ",\"repetitions\":" << s.samples.size() << ",\"times\":[";
+		for (unsigned n = 0; n < s.samples.size(); ++n) os << (n? ",": "") << s.samples[n].ms;
+		os << "],\"min\":" << s.min << ",\"max\":" << s.max << ",\"mean\":" << s.mean << ",\"median\":" << s.median
+		   << ",\"mad\":" << s.mad << ",\"ci_low\":" << s.ciLow << ",\"ci_high\":" << s.ciHigh
+		   << ",\"stddev\":" << s.stddev << ",\"outliers\":" << s.outliers;
+		if (RUSAGE){
+			long minor = 0, major = 0, voluntary = 0, involuntary = 0;
+			for (const auto& sample : s.samples){
+				minor += sample.minorFaults;
+				major += sample.majorFaults;
+				voluntary += sample.voluntarySwitches;
+				involuntary += sample.involuntarySwitches;
+			}
+			os << ",\"minor_faults\":" << minor << ",\"major_faults\":" << major
+			   << ",\"voluntary_switches\":" << voluntary << ",\"involuntary_switches\":" << involuntary;
+		}
+		os << ",\"points_per_s\":" << (s.median > 0? r.points / s.median * 1e3: 0)
+		   << ",\"valid\":" << (r.valid? "true": "false") << "}" << (i+1 < results.size()? ",": "") << std::endl;
+	}
+	os << "]" << std::endl;
+}
+
+// log of a kernel, its name before the extension of the path
+std::string log_path(const std::string& path, const std::string& kernel){
+	const auto slash = path.find_last_of('/');
+	const auto dot = path.find_last_of('.');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) return path + "-" + kernel;
+	return path.substr(0, dot) + "-" + kernel + path.substr(dot);
+}
+
+void write_log(std::ostream& os, const std::string& kernel){
+	for (const auto& r : results){
+		if (r.kernel != kernel) continue;
+		for (const auto& sample : r.timing.samples){
+			os << KIND << ";" << r.engine << ";" << r.size << ";" << r.steps << ";\t" << r.threads << ";\t" << sample.ms << std::endl;
+		}
+	}
+}
+
+//######################## MAIN ###################################################
+
+int main(int argc, char *argv[]) {
+
+	parse_args(argc, argv);
+
+	std::cout << " ~~~~~~~~~~~~~ GO (" << KIND << ", " << warmup << " warmup, " << repetitions << " repetitions) ~~~~~~~~~~~~~" << std::endl;
+	std::cout << std::left << std::setw(10) << "kernel" << std::setw(3) << "D" << std::right << std::setw(9) << "size" << std::setw(7) << "steps"
+			  << "  " << std::left << std::setw(7) << "engine" << std::right << std::setw(5) << "thr"
+			  << std::setw(12) << "median ms" << std::setw(12) << "min ms" << std::setw(12) << "max ms" << std::setw(10) << "MAD"
+			  << std::setw(12) << "Mpoints/s" << std::endl;
+
+	for (const auto& k : kernels){
+
+		const unsigned d = k == "avg1d"? 1: (k == "jacobi2d" || k == "blur3" || k == "gauss9")? 2: 3;
+		if (!dims.empty() && std::find(dims.begin(), dims.end(), d) == dims.end()) continue;
+
+		std::vector<size_t> list = sizes;
+		if (list.empty()) list = { d == 1? (size_t)1000000: d == 2? (size_t)1000: (size_t)100 };
+
+		for (size_t s : list){
+			if (k == "avg1d")    bench<double, 1, example_kernels::Avg_1D_k>(k, s);
+			if (k == "jacobi2d") bench<double, 2, example_kernels::Jacobi_k>(k, s);
+			if (k == "blur3")    bench<float, 2, example_kernels::Blur3_k>(k, s);
+			if (k == "gauss9")   bench<float, 2, Gauss9_k>(k, s);
+			if (k == "heat3d")   bench<double, 3, example_kernels::Heat_3D_k>(k, s);
+			if (k == "avg3d")    bench<double, 3, example_kernels::Avg_3D_k>(k, s);
+			if (k == "star13")   bench<double, 3, example_kernels::Star13_3D_k>(k, s);
+			if (k == "star25")   bench<double, 3, example_kernels::Star25_3D_k>(k, s);
+			if (k == "box27")    bench<double, 3, example_kernels::Box_3D_k>(k, s);
+		}
+	}
+
+	if (!JSON.empty()){
+		std::ofstream out (JSON);
+		write_json(out);
+	}
+	if (!LOG.empty()){
+		for (const auto& k : kernels){
+			if (std::none_of(results.begin(), results.end(), [&] (const Result& r) { return r.kernel == k; })) continue;
+			std::ofstream out (log_path(LOG, k), std::ios::app);
+			write_log(out, k);
+		}
+	}
+
+	bool failed = false;
+	for (const auto& r : results) failed = failed || !r.valid;
+	return failed? 1: 0;
+}
@@ -126,20 +126,17 @@ int main(int argc, char *argv[]) {
 
 	// ~~~~~~~~~~~~~~~~~ create kernel ~~~~~~~~~~~~~~~~~~~~~~~
 	
-	//using KernelType = example_kernels::Color_k<PixelType> kernel(timeSteps);
-	//using KernelType = example_kernels::Copy_k<PixelType>;
-	//using KernelType = example_kernels::Life_k<PixelType>;
-	//using KernelType = example_kernels::Blur3_k<PixelType>;
-	//using KernelType = example_kernels::Blur5_k<PixelType>;
-	//using KernelType = example_kernels::BlurN_k<PixelType, 7>;
+	//using KernelType = example_kernels::Copy_k<ImageSpace>;
+	//using KernelType = example_kernels::Life_k<ImageSpace>;
+	//using KernelType = example_kernels::Blur3_k<ImageSpace>;
+	//using KernelType = example_kernels::Blur5_k<ImageSpace>;
+	//using KernelType = example_kernels::BlurN_k<ImageSpace, 7>;
 	using KernelType = example_kernels::BlurN_k<ImageSpace, 9>;
 
-	KernelType kernel;
-
 	// ~~~~~~~~~~~~~~~~ RUN ~~~~~~~~~~~~~~~~~~~~~~~~~~
 	if (REC || ALL){
 		//TIME_CALL( recursive_stencil( recBuffer, kernel, timeSteps) );
-		auto t = time_call(recursive_stencil<ImageSpace, KernelType>, recBuffer, kernel, timeSteps);
+		auto t = time_call([&] () { recursive_stencil<ImageSpace, KernelType>(recBuffer, timeSteps); });
 		std::cout << "recursive: " << t << "ms" <<std::endl;
 	}
 
@@ -148,7 +145,7 @@ int main(int argc, char *argv[]) {
 			for (unsigned t = 0; t < timeSteps; ++t){
 				P_FOR ( i, 0, getW(iteBuffer), 1, {
 		 			for (unsigned j = 0; j < getH(iteBuffer); ++j){
-						kernel(iteBuffer, i, j, t);
+						KernelType::withBonduaries(iteBuffer, i, j, t);
 					}
 				});
 			}
@@ -163,7 +160,7 @@ int main(int argc, char *argv[]) {
 			for (unsigned t = 0; t < timeSteps; ++t){
 				P_FOR ( j, 0, getH(iteBuffer), 1 , {
 					for (unsigned i = 0; i < getW(iteBuffer); ++i){
-						kernel(invBuffer, i, j, t);
+						KernelType::withBonduaries(invBuffer, i, j, t);
 					}
 				});
 			}
@@ -17,6 +17,7 @@
 
 #include "timer.h" 
 #include "tools/instrument.h" 
+#include "tools/roofline.h"
 
 using namespace stencil;
 
@@ -33,11 +34,13 @@ typedef BufferSet<ElemType, 1> ImageSpace;
 bool REC = false, IT = false, INV = false, ALL = false, VALIDATE=true;
 size_t size = 10;
 int timeSteps = 10;
+std::string REPORT;		// -r: json or csv throughput and roofline lines, alone on stdout
+std::ostream reportOut (std::cout.rdbuf());
 
 
 void help(){
 	std::cout << "Stencil ops:" << std::endl;
-	std::cout << "Stencil [all|it|rec] -s size [-r time steps]" << std::endl;
+	std::cout << "Stencil [all|it|rec] -s size [-t time steps] [-r json|csv]" << std::endl;
 }
 
 void parse_args(int argc, char *argv[]){
@@ -65,6 +68,15 @@ void parse_args(int argc, char *argv[]){
 			i++;
 			timeSteps = std::atoi(argv[i]);
 		}
+		else if (param == "-r"){
+			i++;
+			REPORT = i < argc? argv[i]: "";
+			if (REPORT != "json" && REPORT != "csv"){
+				std::cerr << "-r expects json or csv" << std::endl;
+				help();
+				exit(1);
+			}
+		}
 		else if (param == "-h"){
 
 			help();
@@ -85,12 +97,24 @@ void parse_args(int argc, char *argv[]){
 }
 
 
+// machine readable line per engine, see tools/roofline.h
+template <typename Kernel>
+void report_engine(const std::string& engine, double ms, const ImageSpace& data){
+	if (REPORT.empty()) return;
+	const auto r = roofline::report<ImageSpace, Kernel>(engine, ms, data, timeSteps);
+	if (REPORT == "csv") roofline::print_csv(reportOut, r);
+	else roofline::print_json(reportOut, r);
+}
+
 //######################## MAIN ###################################################
 
 int main(int argc, char *argv[]) {
 
 	// ~~~~~~~~~~~~~~~ Input problem parameters ~~~~~~~~~~~~~~~~~~~~~
 	parse_args(argc, argv);
+
+	// with -r the rest goes to stderr, so the report can be piped
+	if (!REPORT.empty()) std::cout.rdbuf(std::cerr.rdbuf());
 	std::cout <<" execute " << size << " with " << timeSteps << " time steps ";
 	std::cout << "(" << utils::getSizeHuman(sizeof(ElemType) * size) << ")" << std::endl;
 	
@@ -105,6 +129,7 @@ int main(int argc, char *argv[]) {
 	ImageSpace iteBuffer( {{size}}, data);
 
 	std::cout << " ~~~~~~~~~~~~~ GO ~~~~~~~~~~~~~~~~~~~" <<std::endl;
+	if (REPORT == "csv") roofline::print_csv_header(reportOut);
 
 	// ~~~~~~~~~~~~~~~~~ create kernel ~~~~~~~~~~~~~~~~~~~~~~~
 	
@@ -112,8 +137,9 @@ int main(int argc, char *argv[]) {
 
 	// ~~~~~~~~~~~~~~~~ RUN ~~~~~~~~~~~~~~~~~~~~~~~~~~
 	if (REC || ALL){
-		auto t = time_call(recursive_stencil<ImageSpace, KernelType>, recBuffer, timeSteps);
+		auto t = time_call([&] () { recursive_stencil<ImageSpace, KernelType>(recBuffer, timeSteps); });
 		std::cout << "recursive: " << t << "ms" <<std::endl;
+		report_engine<KernelType>("recursive", t, recBuffer);
 	}
 
 	if (IT || ALL){
@@ -130,6 +156,7 @@ int main(int argc, char *argv[]) {
 
 		auto t = time_call(it);
 		std::cout << "iterative: " << t <<"ms" << std::endl;
+		report_engine<KernelType>("iterative", t, iteBuffer);
 	}
 
 	if (ALL && VALIDATE){
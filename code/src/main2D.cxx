@@ -13,9 +13,13 @@
 //#include "rec_stencil_multiple_splits_by_dimension.h"
 
 #include "new_rec_stencil.h"
+#include "overlapped_tiling.h"
+#include "wavefront.h"
+#include "iterative_stencil.h"
 
 #include "timer.h" 
 #include "tools/instrument.h" 
+#include "tools/roofline.h"
 
 using namespace stencil;
 
@@ -27,15 +31,18 @@ typedef BufferSet<PixelType, 2> ImageSpace;
 
  // #######################################################################################
 
-bool REC = false, IT = false, INV = false, ALL = false, VALIDATE=true, VISUALIZE=false;
+bool REC = false, IT = false, INV = false, OVL = false, WAVE = false, TILED = false, ALL = false, VALIDATE=true, VISUALIZE=false;
 
 	int timeSteps = 10;
 	size_t size = 10;
+	unsigned tileSteps = 8;
+	std::string REPORT;		// -r: json or csv throughput and roofline lines, alone on stdout
+	std::ostream reportOut (std::cout.rdbuf());
 
 
 void help(){
 	std::cout << "Stencil ops:" << std::endl;
-	std::cout << "Stencil2D [all|it|rec] -i image [-t time steps]" << std::endl;
+	std::cout << "Stencil2D [all|it|rec|ovl|wave|tiled] -i image [-t time steps] [-k time steps per tile] [-r json|csv]" << std::endl;
 }
 
 void parse_args(int argc, char *argv[]){
@@ -53,6 +60,15 @@ void parse_args(int argc, char *argv[]){
 		else if(param == "inv") {
 			INV = true;
 		}
+		else if(param == "ovl") {
+			OVL = true;
+		}
+		else if(param == "wave") {
+			WAVE = true;
+		}
+		else if(param == "tiled") {
+			TILED = true;
+		}
 		else if (param == "-s"){
 			i++;
 			size = std::atoi(argv[i]);
@@ -61,6 +77,19 @@ void parse_args(int argc, char *argv[]){
 			i++;
 			timeSteps = std::atoi(argv[i]);
 		}
+		else if (param == "-k"){
+			i++;
+			tileSteps = std::atoi(argv[i]);
+		}
+		else if (param == "-r"){
+			i++;
+			REPORT = i < argc? argv[i]: "";
+			if (REPORT != "json" && REPORT != "csv"){
+				std::cerr << "-r expects json or csv" << std::endl;
+				help();
+				exit(1);
+			}
+		}
 		else if (param == "-h"){
 
 			help();
@@ -78,12 +107,21 @@ void parse_args(int argc, char *argv[]){
 		i++;
 	}
 
-	ALL = !(IT || REC || INV);
+	ALL = !(IT || REC || INV || OVL || WAVE || TILED);
 
 	VALIDATE =  ALL;
 }
 
 
+// machine readable line per engine, see tools/roofline.h
+template <typename Kernel>
+void report_engine(const std::string& engine, double ms, const ImageSpace& data){
+	if (REPORT.empty()) return;
+	const auto r = roofline::report<ImageSpace, Kernel>(engine, ms, data, timeSteps);
+	if (REPORT == "csv") roofline::print_csv(reportOut, r);
+	else roofline::print_json(reportOut, r);
+}
+
 //######################## MAIN ###################################################
 
 int main(int argc, char *argv[]) {
@@ -91,6 +129,9 @@ int main(int argc, char *argv[]) {
 	// ~~~~~~~~~~~~~~~ Input problem parameters ~~~~~~~~~~~~~~~~~~~~~
 	parse_args(argc, argv);
 
+	// with -r the rest goes to stderr, so the report can be piped
+	if (!REPORT.empty()) std::cout.rdbuf(std::cerr.rdbuf());
+
 	// ~~~~~~~~~~~~~~~ Generate Input ~~~~~~~~~~~~~~~~~~~~~~~~~~~
 	
 	std::cout <<" execute " << size << "^2 with " << timeSteps << " time steps ";
@@ -104,8 +145,12 @@ int main(int argc, char *argv[]) {
 	ImageSpace recBuffer( { size, size }, data);
 	ImageSpace iteBuffer( { size, size }, data);
 	ImageSpace invBuffer( { size, size }, data);
+	ImageSpace ovlBuffer( { size, size }, data);
+	ImageSpace waveBuffer( { size, size }, data);
+	ImageSpace tiledBuffer( { size, size }, data);
 
 	std::cout << " ~~~~~~~~~~~~~ GO ~~~~~~~~~~~~~~~~~~~" <<std::endl;
+	if (REPORT == "csv") roofline::print_csv_header(reportOut);
 
 	// ~~~~~~~~~~~~~~~~~ create kernel ~~~~~~~~~~~~~~~~~~~~~~~
 	
@@ -122,8 +167,9 @@ int main(int argc, char *argv[]) {
 	// ~~~~~~~~~~~~~~~~ RUN ~~~~~~~~~~~~~~~~~~~~~~~~~~
 	if (REC || ALL){
 		//TIME_CALL( recursive_stencil( recBuffer, kernel, timeSteps) );
-		auto t = time_call(recursive_stencil<ImageSpace, KernelType>, recBuffer, timeSteps);
+		auto t = time_call([&] () { recursive_stencil<ImageSpace, KernelType>(recBuffer, timeSteps); });
 		std::cout << "recursive: " << t << "ms" <<std::endl;
+		report_engine<KernelType>("recursive", t, recBuffer);
 	}
 
 	if (IT || ALL){
@@ -142,6 +188,7 @@ int main(int argc, char *argv[]) {
 
 		auto t = time_call(it);
 		std::cout << "iterative: " << t <<"ms" << std::endl;
+		report_engine<KernelType>("iterative", t, iteBuffer);
 	}
 
 	if (INV || ALL){
@@ -160,10 +207,36 @@ int main(int argc, char *argv[]) {
 
 		auto t = time_call(it);
 		std::cout << "inverted: " << t << "ms" <<std::endl;
+		report_engine<KernelType>("inverted", t, invBuffer);
+	}
+
+	if (OVL || ALL){
+		const int tile = MAX(size/4, (size_t)1);
+		TilingReport report;
+		auto t = time_call([&] () { report = overlapped_stencil<ImageSpace, KernelType>(ovlBuffer, timeSteps, {{tile, tile}}, tileSteps); });
+		std::cout << "overlapped: " << t << "ms (" << report.tiles << " tiles, redundancy " << report.redundancy << ")" << std::endl;
+		report_engine<KernelType>("overlapped", t, ovlBuffer);
+	}
+
+	if (WAVE || ALL){
+		const int width = size/8;
+		auto t = time_call(wavefront_stencil<ImageSpace, KernelType>, waveBuffer, timeSteps, width, tileSteps);
+		std::cout << "wavefront: " << t << "ms" << std::endl;
+		report_engine<KernelType>("wavefront", t, waveBuffer);
+	}
+
+	if (TILED || ALL){
+		std::array<int, 2> block {{ (int)size, 16 }};
+		auto t = time_call([&] () { iterative_stencil<ImageSpace, KernelType>(tiledBuffer, timeSteps, block); });
+		std::cout << "tiled: " << t << "ms" << std::endl;
+		report_engine<KernelType>("tiled", t, tiledBuffer);
 	}
 
 	if (ALL && VALIDATE){
 		if (recBuffer != iteBuffer) std::cout << "VALIDATION FAILED" << std::endl;
+		else if (ovlBuffer != recBuffer) std::cout << "VALIDATION FAILED" << std::endl;
+		else if (waveBuffer != recBuffer) std::cout << "VALIDATION FAILED" << std::endl;
+		else if (tiledBuffer != recBuffer) std::cout << "VALIDATION FAILED" << std::endl;
 		else if (invBuffer != iteBuffer) std::cout << "VALIDATION FAILED" << std::endl;
 		else if (invBuffer != recBuffer) std::cout << "VALIDATION FAILED" << std::endl;
 		else std::cout << "VALIDATION OK" << std::endl;
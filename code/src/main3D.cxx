@@ -14,9 +14,17 @@
 //#include "rec_stencil_multiple_splits_by_dimension.h"
 
 #include "new_rec_stencil.h"
+#include "overlapped_tiling.h"
+#include "wavefront.h"
+#include "iterative_stencil.h"
 
 #include "timer.h"
 #include "tools/instrument.h" 
+#include "tools/roofline.h"
+
+#ifdef STENCIL_MPI
+#	include "mpi_stencil.h"
+#endif
  
 
 using namespace stencil;
@@ -67,14 +75,21 @@ typedef BufferSet<VoxelType, 3> ImageSpace;
 
  // #######################################################################################
 
-bool REC = false, IT = false, INV = false, ALL = false, VALIDATE=true;
+bool REC = false, IT = false, INV = false, OVL = false, WAVE = false, TILED = false, ALL = false, VALIDATE=true;
 size_t size = 10;
 int timeSteps = 10;
+std::string REPORT;		// -r: json or csv throughput and roofline lines, alone on stdout
+std::ostream reportOut (std::cout.rdbuf());
+unsigned haloSteps = 4;		// steps per epoch: between halo exchanges, or per tile
+bool blocking = false;
 
 
 void help(){
 	std::cout << "Stencil ops:" << std::endl;
-	std::cout << "Stencil [all|it|rec] -s size [-r time steps]" << std::endl;
+	std::cout << "Stencil [all|it|rec|ovl|wave|tiled] -s size [-t time steps] [-k time steps per tile/halo exchange] [-r json|csv]" << std::endl;
+#ifdef STENCIL_MPI
+	std::cout << "        [-b blocking exchange]" << std::endl;
+#endif
 }
 
 void parse_args(int argc, char *argv[]){
@@ -92,6 +107,15 @@ void parse_args(int argc, char *argv[]){
 		else if(param == "inv") {
 			INV = true;
 		}
+		else if(param == "ovl") {
+			OVL = true;
+		}
+		else if(param == "wave") {
+			WAVE = true;
+		}
+		else if(param == "tiled") {
+			TILED = true;
+		}
 		else if (param == "-s"){
 
 			i++;
@@ -102,6 +126,23 @@ void parse_args(int argc, char *argv[]){
 			i++;
 			timeSteps = std::atoi(argv[i]);
 		}
+		else if (param == "-k"){
+
+			i++;
+			haloSteps = std::atoi(argv[i]);
+		}
+		else if (param == "-b"){
+			blocking = true;
+		}
+		else if (param == "-r"){
+			i++;
+			REPORT = i < argc? argv[i]: "";
+			if (REPORT != "json" && REPORT != "csv"){
+				std::cerr << "-r expects json or csv" << std::endl;
+				help();
+				exit(1);
+			}
+		}
 		else if (param == "-h"){
 
 			help();
@@ -116,18 +157,90 @@ void parse_args(int argc, char *argv[]){
 		i++;
 	}
 
-	ALL = !(IT || REC || INV);
+	ALL = !(IT || REC || INV || OVL || WAVE || TILED);
 
 	VALIDATE =  ALL;
 }
 
 
+//######################## MPI ####################################################
+
+#ifdef STENCIL_MPI
+
+int mpi_main(int argc, char *argv[]) {
+
+	MPI_Init(&argc, &argv);
+	int rank, ranks;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+	parse_args(argc, argv);
+	if (rank == 0){
+		std::cout <<" execute " << size << "^3 with " << timeSteps << " time steps on " << ranks << " ranks, halo for " << haloSteps << " steps ";
+		std::cout << "(" << utils::getSizeHuman(sizeof(VoxelType) * size*size*size) << ")" << std::endl;
+	}
+
+	// the input is a function of the global position, each rank generates only its slab
+	auto input = [] (size_t p) { return (VoxelType)((p * 2654435761u) % 1000003) / 1000003; };
+
+	using KernelType = example_kernels::Avg_3D_k<ImageSpace>;
+	typedef MPIStencil3D<VoxelType, KernelType> Distributed;
+
+	const size_t plane = (size_t)size*size;
+	const size_t first = Distributed::slab_begin(rank, ranks, size);
+	const size_t last = Distributed::slab_begin(rank+1, ranks, size);
+	std::vector<VoxelType> slab (plane*(last - first));
+	for (size_t p = 0; p < slab.size(); ++p) slab[p] = input(plane*first + p);
+
+	Distributed mine (MPI_COMM_WORLD, {{size, size, size}}, haloSteps, slab.data());
+	mine.setOverlap(!blocking);
+	std::vector<VoxelType>().swap(slab);
+
+	MPI_Barrier(MPI_COMM_WORLD);
+	auto t = time_call([&] () { mine.run(timeSteps); MPI_Barrier(MPI_COMM_WORLD); });
+	if (rank == 0) std::cout << "distributed: " << t << "ms" <<std::endl;
+
+	// only validation needs the whole domain, in rank 0
+	int failed = 0;
+	const auto result = VALIDATE? mine.gather(): std::vector<VoxelType>();
+	if (rank == 0 && VALIDATE){
+		std::vector<VoxelType> data (plane*size);
+		for (size_t p = 0; p < data.size(); ++p) data[p] = input(p);
+		ImageSpace recBuffer( {{size, size, size}}, data);
+		recursive_stencil<ImageSpace, KernelType>(recBuffer, timeSteps);
+		failed = memcmp(recBuffer.getCurrentPointer(), result.data(), result.size()*sizeof(VoxelType)) != 0;
+		if (failed) std::cout << "VALIDATION FAILED" << std::endl;
+		else        std::cout << "VALIDATION OK" << std::endl;
+	}
+
+	MPI_Finalize();
+	return failed;
+}
+
+#endif
+
+// machine readable line per engine, see tools/roofline.h
+template <typename Kernel>
+void report_engine(const std::string& engine, double ms, const ImageSpace& data){
+	if (REPORT.empty()) return;
+	const auto r = roofline::report<ImageSpace, Kernel>(engine, ms, data, timeSteps);
+	if (REPORT == "csv") roofline::print_csv(reportOut, r);
+	else roofline::print_json(reportOut, r);
+}
+
 //######################## MAIN ###################################################
 
 int main(int argc, char *argv[]) {
 
+#ifdef STENCIL_MPI
+	return mpi_main(argc, argv);
+#endif
+
 	// ~~~~~~~~~~~~~~~ Input problem parameters ~~~~~~~~~~~~~~~~~~~~~
 	parse_args(argc, argv);
+
+	// with -r the rest goes to stderr, so the report can be piped
+	if (!REPORT.empty()) std::cout.rdbuf(std::cerr.rdbuf());
 	std::cout <<" execute " << size << "^3 with " << timeSteps << " time steps ";
 	std::cout << "(" << utils::getSizeHuman(sizeof(VoxelType) * size*size*size) << ")" << std::endl;
 	
@@ -141,8 +254,12 @@ int main(int argc, char *argv[]) {
 	ImageSpace recBuffer( {{size, size, size}}, data);
 	ImageSpace iteBuffer( {{size, size, size}}, data);
 	ImageSpace invBuffer( {{size, size, size}}, data);
+	ImageSpace ovlBuffer( {{size, size, size}}, data);
+	ImageSpace waveBuffer( {{size, size, size}}, data);
+	ImageSpace tiledBuffer( {{size, size, size}}, data);
 
 	std::cout << " ~~~~~~~~~~~~~ GO ~~~~~~~~~~~~~~~~~~~" <<std::endl;
+	if (REPORT == "csv") roofline::print_csv_header(reportOut);
 
 	// ~~~~~~~~~~~~~~~~~ create kernel ~~~~~~~~~~~~~~~~~~~~~~~
 	
@@ -150,8 +267,9 @@ int main(int argc, char *argv[]) {
 
 	// ~~~~~~~~~~~~~~~~ RUN ~~~~~~~~~~~~~~~~~~~~~~~~~~
 	if (REC || ALL){
-		auto t = time_call(recursive_stencil<ImageSpace, KernelType>, recBuffer, timeSteps);
+		auto t = time_call([&] () { recursive_stencil<ImageSpace, KernelType>(recBuffer, timeSteps); });
 		std::cout << "recursive: " << t << "ms" <<std::endl;
+		report_engine<KernelType>("recursive", t, recBuffer);
 	}
 
 	if (IT || ALL){
@@ -171,6 +289,7 @@ int main(int argc, char *argv[]) {
 
 		auto t = time_call(it);
 		std::cout << "iterative: " << t <<"ms" << std::endl;
+		report_engine<KernelType>("iterative", t, iteBuffer);
 	}
 
 	if (INV || ALL){
@@ -190,10 +309,36 @@ int main(int argc, char *argv[]) {
 
 		auto t = time_call(it);
 		std::cout << "inverted: " << t << "ms" <<std::endl;
+		report_engine<KernelType>("inverted", t, invBuffer);
+	}
+
+	if (OVL || ALL){
+		const int tile = MAX(size/4, (size_t)1);
+		TilingReport report;
+		auto t = time_call([&] () { report = overlapped_stencil<ImageSpace, KernelType>(ovlBuffer, timeSteps, {{tile, tile, tile}}, haloSteps); });
+		std::cout << "overlapped: " << t << "ms (" << report.tiles << " tiles, redundancy " << report.redundancy << ")" << std::endl;
+		report_engine<KernelType>("overlapped", t, ovlBuffer);
+	}
+
+	if (WAVE || ALL){
+		const int width = size/8;
+		auto t = time_call(wavefront_stencil<ImageSpace, KernelType>, waveBuffer, timeSteps, width, haloSteps);
+		std::cout << "wavefront: " << t << "ms" << std::endl;
+		report_engine<KernelType>("wavefront", t, waveBuffer);
+	}
+
+	if (TILED || ALL){
+		std::array<int, 3> block {{ (int)size, 16, 8 }};
+		auto t = time_call([&] () { iterative_stencil<ImageSpace, KernelType>(tiledBuffer, timeSteps, block); });
+		std::cout << "tiled: " << t << "ms" << std::endl;
+		report_engine<KernelType>("tiled", t, tiledBuffer);
 	}
 
 	if (ALL && VALIDATE){
 		if (recBuffer != invBuffer) std::cout << "VALIDATION FAILED" << std::endl;
+		else if (ovlBuffer != recBuffer) std::cout << "VALIDATION FAILED" << std::endl;
+		else if (waveBuffer != recBuffer) std::cout << "VALIDATION FAILED" << std::endl;
+		else if (tiledBuffer != recBuffer) std::cout << "VALIDATION FAILED" << std::endl;
 		else if (invBuffer != iteBuffer) std::cout << "VALIDATION FAILED" << std::endl;
 		else if (iteBuffer != recBuffer) std::cout << "VALIDATION FAILED" << std::endl;
 		else std::cout << "VALIDATION OK" << std::endl;
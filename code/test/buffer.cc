@@ -263,6 +263,51 @@ TEST(Buffer, Getters){
 	}
 }
 
+TEST(Buffer, Auxiliary){
+
+	std::vector<int> v = {0,1,2,3,4, 0,1,2,3,4};
+	std::vector<int> c = {9,8,7,6,5, 4,3,2,1,0};
+
+	BufferSet<int,2> b ({5,2}, v);
+	BufferSet<int,2> o ({5,2}, v);
+	EXPECT_EQ (0u, getAuxiliaries(b));
+	EXPECT_EQ (0u, getAuxiliaries(v));
+
+	for (int i=0; i<5; ++i)
+		for (int j=0; j<2; ++j){
+			getElem(b, i, j, 1) = 42;
+			getElem(o, i, j, 1) = 42;
+		}
+	EXPECT_EQ (0u, b.attach(c));
+	EXPECT_EQ (1u, b.attach(v));
+	EXPECT_EQ (2u, getAuxiliaries(b));
+
+	// the copies are untouched, the fields follow them with the same layout
+	for (int i=0; i<5; ++i)
+		for (int j=0; j<2; ++j){
+			EXPECT_EQ(getElem(b, i, j, 0), i);
+			EXPECT_EQ(getAux(b, i, j, 0), c[i+j*5]);
+			EXPECT_EQ(getAux(b, i, j, 1), i);
+			EXPECT_EQ(getElem(b, i, j, 1), 42);
+		}
+	EXPECT_EQ(b.getAuxPointer(1), b.getPointer(0) + 3*b.getSize());
+
+	// fields count for equality
+	EXPECT_FALSE(b == o);
+	o.attach(c);
+	o.attach(v);
+	EXPECT_TRUE(b == o);
+
+	auto b2 = std::move(b);
+	EXPECT_EQ (2u, getAuxiliaries(b2));
+	EXPECT_EQ (0u, getAuxiliaries(b));
+	EXPECT_EQ(getAux(b2, 4, 1, 0), 0);
+
+	BufferSet<double,3> d ({2,2,2}, std::vector<double>(8, 0.0));
+	d.attach(std::vector<double>(8, 0.5));
+	EXPECT_EQ(0.5, getAux(d, 1, 1, 1, 0));
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 TEST(Buffer2, Constructor){
@@ -524,4 +569,17 @@ TEST(Buffer2, Getters){
 	}
 }
 
+TEST(Buffer2, CurrentCopy){
+
+	std::vector<int> v = {0,1,2,3,4};
+	BufferSet2<int,1> b ({5}, v);
+	EXPECT_EQ (0u, b.getCurrentCopy());
+	EXPECT_EQ (3, b.getCurrentPointer()[2*3]);
+
+	b.setTime(7);
+	EXPECT_EQ (1u, b.getCurrentCopy());
+	EXPECT_EQ (&getElem(b, 0, 1), b.getCurrentPointer());
+	EXPECT_EQ (&getElem(b, 4, 1), b.getCurrentPointer() + 2*4);
+}
+
 
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include "kernel.h"
+#include "new_rec_stencil.h"
+#include "iterative_stencil.h"
+#include "kernels_1D.h"
+#include "kernels_2D.h"
+#include "kernels_3D.h"
+
+using namespace stencil;
+using namespace stencil::example_kernels;
+
+
+template <typename Data>
+std::vector<Data> initData(int size){
+	std::vector<Data> data (size);
+	for (auto i =1; i< size; ++i) 	data[i] = i%13;
+	return data;
+}
+
+TEST(Iterative, AVG_1D){
+
+	typedef double Type;
+	const int SIZE = 1000;
+	const int TIMESTEPS = 31;
+
+	typedef BufferSet<Type, 1> Buffer;
+	using KernelType = Avg_1D_k<Buffer>;
+
+	auto data  = initData<Type> (SIZE);
+	Buffer rec ({SIZE}, data);
+	Buffer it ({SIZE}, data);
+
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+	iterative_stencil<Buffer, KernelType>(it, TIMESTEPS, {{96}});
+	EXPECT_EQ(TIMESTEPS, it.getTime());
+	EXPECT_TRUE(rec == it);
+}
+
+TEST(Iterative, Life_2D){
+
+	typedef bool Type;
+	const int SIZE = 90;
+	const int TIMESTEPS = 40;
+
+	typedef BufferSet<Type, 2> Buffer;
+	using KernelType = Life_k<Buffer>;
+
+	std::vector<Type> data (SIZE*SIZE);
+	for (int i = 0; i < SIZE*SIZE; ++i) data[i] = (i*7919)%3 == 0;
+
+	Buffer rec ({SIZE, SIZE}, data);
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+
+	// whole rows, cut rows, blocks not dividing the domain
+	for (auto block : {std::array<int, 2>{{SIZE, 8}}, std::array<int, 2>{{16, 16}}, std::array<int, 2>{{37, 1}}}){
+		Buffer it ({SIZE, SIZE}, data);
+		iterative_stencil<Buffer, KernelType>(it, TIMESTEPS, block);
+		EXPECT_TRUE(rec == it) << " block " << block[0] << "x" << block[1];
+	}
+}
+
+TEST(Iterative, Heat_3D){
+
+	typedef double Type;
+	const int SIZE = 34;
+	const int TIMESTEPS = 15;
+
+	typedef BufferSet<Type, 3> Buffer;
+	using KernelType = Heat_3D_k<Buffer>;
+
+	auto data  = initData<Type> (SIZE*SIZE*SIZE);
+	Buffer rec ({SIZE, SIZE, SIZE}, data);
+	Buffer it ({SIZE, SIZE, SIZE}, data);
+
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+	iterative_stencil<Buffer, KernelType>(it, TIMESTEPS, {{SIZE, 8, 5}});
+	EXPECT_TRUE(rec == it);
+}
@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <functional>
+
 #include "kernel.h"
 #include "kernels_2D.h"
 
@@ -81,77 +84,39 @@ TEST(Kernel, Operator){
 }
 
 
-/*
 TEST(Kernel, Gaussian_Blur){
 
 	using namespace example_kernels;
+	typedef BufferSet<double, 2> Space;
 
-	{
-		BlurN_k<double, 3> kernel;
+	// computed by the compiler
+	static_assert(Gaussian<5>::coefficients[2] > Gaussian<5>::coefficients[1], "peak in the center");
+	static_assert(Gaussian<5>::coefficients[1] > Gaussian<5>::coefficients[0], "decreasing");
+	static_assert(BlurN_k<Space, 9>::neighbours == 4u, "half the size");
 
-		std::cout << "size 3:\n ";
-		double sum = 0.0;
-		for (auto i = 0; i < 3; ++i){
-			for (auto j = 0; j < 3; ++j){
-				std::cout  << kernel.Kcoeff[i][j] << ",\t";
-				sum += kernel.Kcoeff[i][j];
-			}
-			std::cout << "\n ";
-		}
-		ASSERT_NEAR(1, sum, 0.00001);
+	const double sigma = 0.3 * (2 * 0.5 - 1) + 0.8;
+	EXPECT_NEAR(std::exp(-1 / (2*sigma*sigma)) / (1 + 2*std::exp(-1 / (2*sigma*sigma))), Gaussian<3>::coefficients[0], 1e-12);
 
-		for (auto i = 0; i < 3; ++i){
-			for (auto j = 0; j < 3; ++j){
-				EXPECT_EQ( kernel.Kcoeff[i][j], kernel.Kcoeff[j][i]);
-			}
-		}
-		
-	}
-
-	{
-		BlurN_k<double, 5> kernel;
-
-
-		std::cout << "size 5:\n ";
+	auto check = [] (int size, std::function<double (int, int)> coefficient){
+		const int r = size/2;
 		double sum = 0.0;
-		for (auto i = 0; i < 5; ++i){
-			for (auto j = 0; j < 5; ++j){
-				std::cout  << kernel.Kcoeff[i][j] << ",\t";
-				sum += kernel.Kcoeff[i][j];
+		for (int x = -r; x <= r; ++x){
+			for (int y = -r; y <= r; ++y){
+				sum += coefficient(x, y);
+				EXPECT_EQ(coefficient(x, y), coefficient(y, x));
+				EXPECT_EQ(coefficient(x, y), coefficient(-x, y));
+				if (x < 0){
+					EXPECT_LT(coefficient(x, y), coefficient(x+1, y));
+				}
 			}
-			std::cout << "\n ";
 		}
-		ASSERT_NEAR(1, sum, 0.00001);
-		
-		for (auto i = 0; i < 5; ++i){
-			for (auto j = 0; j < 5; ++j){
-				EXPECT_EQ( kernel.Kcoeff[i][j], kernel.Kcoeff[j][i]);
-			}
-		}
-	}
-	
-	{
-		BlurN_k<double, 7> kernel;
-
-
-		std::cout << "size 7:\n ";
-		double sum = 0.0;
-		for (auto i = 0; i < 7; ++i){
-			for (auto j = 0; j < 7; ++j){
-				std::cout  << kernel.Kcoeff[i][j] << ",\t";
-				sum += kernel.Kcoeff[i][j];
-			}
-			std::cout << "\n ";
-		}
-		ASSERT_NEAR(1, sum, 0.00001);
-		
-		for (auto i = 0; i < 7; ++i){
-			for (auto j = 0; j < 7; ++j){
-				EXPECT_EQ( kernel.Kcoeff[i][j], kernel.Kcoeff[j][i]);
-			}
-		}
-	}
-}*/
+		EXPECT_NEAR(1, sum, 1e-12) << " size " << size;
+	};
+	check(3, BlurN_k<Space, 3>::coefficient);
+	check(5, BlurN_k<Space, 5>::coefficient);
+	check(7, BlurN_k<Space, 7>::coefficient);
+	check(11, BlurN_k<Space, 11>::coefficient);
+}
 
 TEST(Kernel, SolveRoutine){
 
@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "kernel_dsl.h"
+#include "new_rec_stencil.h"
+#include "iterative_stencil.h"
+#include "wavefront.h"
+#include "kernels_2D.h"
+
+using namespace stencil;
+
+
+template <typename Data>
+std::vector<Data> initData(int size){
+	std::vector<Data> data (size);
+	for (auto i = 0; i < size; ++i) data[i] = (i*7919)%13;
+	return data;
+}
+
+// upwind in 1D, reads two points to the left
+struct Upwind{
+	typedef dsl::Offsets<dsl::Offset<-2>, dsl::Offset<0>, dsl::Offset<1>> shape;
+
+	template <typename Neighbourhood>
+	static double apply(const Neighbourhood& n){
+		return 0.25*n[0] + 0.5*n[1] + 0.25*n[2];
+	}
+};
+
+// average of the 7 point star, only over the points inside the domain
+struct Star{
+	typedef dsl::Offsets<dsl::Offset<0,0,0>,
+						 dsl::Offset<-1,0,0>, dsl::Offset<1,0,0>,
+						 dsl::Offset<0,-1,0>, dsl::Offset<0,1,0>,
+						 dsl::Offset<0,0,-1>, dsl::Offset<0,0,1>> shape;
+	static const unsigned flops = 8;
+
+	template <typename Neighbourhood>
+	static double apply(const Neighbourhood& n){
+		double sum = 0.0;
+		int count = 0;
+		for (unsigned k = 0; k < shape::count; ++k){
+			if (!n.inside(k)) continue;
+			sum += n[k];
+			count++;
+		}
+		return sum / count;
+	}
+};
+
+TEST(KernelDSL, Shapes){
+
+	typedef Upwind::shape Up;
+	static_assert(Up::dimensions == 1u, "derived from the shape");
+	static_assert(Up::count == 3u, "derived from the shape");
+	static_assert(Up::reach == 2u, "derived from the shape");
+	EXPECT_EQ(-2, Up::offset(0, 0));
+	EXPECT_EQ(1, Up::offset(2, 0));
+
+	typedef dsl::Offsets<dsl::Offset<0,0>, dsl::Offset<3,-1>> Pair;
+	static_assert(Pair::dimensions == 2u, "derived from the shape");
+	static_assert(Pair::reach == 3u, "derived from the shape");
+	EXPECT_EQ(-1, Pair::offset(1, 1));
+
+	// the last dimension runs fastest
+	typedef dsl::Box<2, 1> Box;
+	static_assert(Box::count == 9u, "derived from the shape");
+	EXPECT_EQ(-1, Box::offset(0, 0));
+	EXPECT_EQ(-1, Box::offset(0, 1));
+	EXPECT_EQ(-1, Box::offset(2, 0));
+	EXPECT_EQ(1, Box::offset(2, 1));
+	EXPECT_EQ(1, Box::offset(8, 0));
+	static_assert(dsl::Box<3, 2>::count == 125u, "derived from the shape");
+
+	typedef BufferSet<double, 1> Buffer1;
+	static_assert(dsl::Stencil<Buffer1, Upwind>::neighbours == 2u, "derived from the shape");
+	static_assert(dsl::Stencil<Buffer1, Upwind>::flops == 6u, "derived from the shape");
+	typedef BufferSet<double, 3> Buffer3;
+	static_assert(dsl::Stencil<Buffer3, Star>::neighbours == 1u, "derived from the shape");
+	static_assert(dsl::Stencil<Buffer3, Star>::flops == 8u, "derived from the shape");
+	static_assert(example_kernels::Blur5_k<BufferSet<float, 2>>::neighbours == 2u, "derived from the shape");
+}
+
+TEST(KernelDSL, Upwind_1D){
+
+	typedef BufferSet<double, 1> Buffer;
+	typedef dsl::Stencil<Buffer, Upwind> KernelType;
+	const int SIZE = 500;
+	const int TIMESTEPS = 40;
+
+	auto data = initData<double>(SIZE);
+	Buffer rec ({SIZE}, data);
+	Buffer it ({SIZE}, data);
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+	iterative_stencil<Buffer, KernelType>(it, TIMESTEPS, {{64}});
+	EXPECT_TRUE(rec == it);
+
+	// by hand, outer points are zero
+	std::vector<double> ref = data, next (SIZE);
+	for (int t = 0; t < TIMESTEPS; ++t){
+		for (int i = 0; i < SIZE; ++i){
+			next[i] = 0.25*(i >= 2? ref[i-2]: 0.0) + 0.5*ref[i] + 0.25*(i+1 < SIZE? ref[i+1]: 0.0);
+		}
+		std::swap(ref, next);
+	}
+	for (int i = 0; i < SIZE; ++i) ASSERT_DOUBLE_EQ(ref[i], getElem(rec, i, TIMESTEPS)) << " at " << i;
+}
+
+TEST(KernelDSL, Blur5_2D){
+
+	typedef float Type;
+	typedef BufferSet<Type, 2> Buffer;
+	typedef example_kernels::Blur5_k<Buffer> KernelType;
+	const int SIZE = 61;
+	const int TIMESTEPS = 9;
+
+	auto data = initData<Type>(SIZE*SIZE);
+	Buffer rec ({SIZE, SIZE}, data);
+	Buffer it ({SIZE, SIZE}, data);
+	Buffer wave ({SIZE, SIZE}, data);
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+	iterative_stencil<Buffer, KernelType>(it, TIMESTEPS, {{SIZE, 7}});
+	wavefront_stencil<Buffer, KernelType>(wave, TIMESTEPS, 10, 4);
+	EXPECT_TRUE(rec == it);
+	EXPECT_TRUE(rec == wave);
+
+	// the whole 5x5 box, also near the border
+	std::vector<Type> ref = data, next (SIZE*SIZE);
+	for (int t = 0; t < TIMESTEPS; ++t){
+		for (int j = 0; j < SIZE; ++j){
+			for (int i = 0; i < SIZE; ++i){
+				double sum = 0.0;
+				for (int x = i-2; x <= i+2; ++x){
+					for (int y = j-2; y <= j+2; ++y){
+						if (x < 0 || y < 0 || x >= SIZE || y >= SIZE) continue;
+						sum += ref[x + y*SIZE] * example_kernels::Blur5_weights::weight((x-i+2)*5 + (y-j+2));
+					}
+				}
+				next[i + j*SIZE] = sum;
+			}
+		}
+		std::swap(ref, next);
+	}
+	for (int j = 0; j < SIZE; ++j){
+		for (int i = 0; i < SIZE; ++i){
+			ASSERT_FLOAT_EQ(ref[i + j*SIZE], getElem(rec, i, j, TIMESTEPS)) << " at " << i << "," << j;
+		}
+	}
+}
+
+TEST(KernelDSL, Star_3D){
+
+	typedef BufferSet<double, 3> Buffer;
+	typedef dsl::Stencil<Buffer, Star> KernelType;
+	const int SIZE = 24;
+	const int TIMESTEPS = 11;
+
+	auto data = initData<double>(SIZE*SIZE*SIZE);
+	Buffer rec ({SIZE, SIZE, SIZE}, data);
+	Buffer it ({SIZE, SIZE, SIZE}, data);
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+	iterative_stencil<Buffer, KernelType>(it, TIMESTEPS, {{SIZE, 8, 5}});
+	EXPECT_TRUE(rec == it);
+
+	// a corner averages 4 points, an inner point 7
+	Buffer one ({SIZE, SIZE, SIZE}, data);
+	recursive_stencil<Buffer, KernelType>(one, 1);
+	auto at = [&] (int i, int j, int k) { return data[i + j*SIZE + k*SIZE*SIZE]; };
+	EXPECT_DOUBLE_EQ((at(0,0,0) + at(1,0,0) + at(0,1,0) + at(0,0,1)) / 4, getElem(one, 0, 0, 0, 1));
+	EXPECT_DOUBLE_EQ((at(5,5,5) + at(4,5,5) + at(6,5,5) + at(5,4,5) + at(5,6,5) + at(5,5,4) + at(5,5,6)) / 7, getElem(one, 5, 5, 5, 1));
+}
+
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include "kernel.h"
+#include "new_rec_stencil.h"
+#include "overlapped_tiling.h"
+#include "kernels_1D.h"
+#include "kernels_2D.h"
+#include "kernels_3D.h"
+
+using namespace stencil;
+using namespace stencil::example_kernels;
+
+
+template <typename Data>
+std::vector<Data> initData(int size){
+	std::vector<Data> data (size);
+	for (auto i =1; i< size; ++i) 	data[i] = i%23;
+	return data;
+}
+
+TEST(OverlappedTiling, AVG_1D){
+
+	typedef double Type;
+	const int SIZE = 1000;
+	const int TIMESTEPS = 45;
+
+	typedef BufferSet<Type, 1> Buffer;
+	using KernelType = Avg_1D_k<Buffer>;
+
+	auto data  = initData<Type> (SIZE);
+
+	Buffer rec ({SIZE}, data);
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+
+	for (unsigned k : {1, 7, 16, 100}){
+		Buffer tiled ({SIZE}, data);
+		auto report = overlapped_stencil<Buffer, KernelType>(tiled, TIMESTEPS, {{128}}, k);
+
+		EXPECT_EQ(8, report.tiles);
+		EXPECT_EQ((TIMESTEPS+k-1)/k, report.epochs);
+		EXPECT_GE(report.redundancy, 1.0);
+		EXPECT_EQ(TIMESTEPS, tiled.getTime());
+		EXPECT_TRUE(rec == tiled) << " k " << k;
+	}
+}
+
+TEST(OverlappedTiling, Blur_2D){
+
+	typedef double Type;
+	const int SIZE = 130;
+	const int TIMESTEPS = 33;
+
+	typedef BufferSet<Type, 2> Buffer;
+	using KernelType = Blur3_k<Buffer>;
+
+	auto data  = initData<Type> (SIZE*SIZE);
+
+	Buffer rec ({SIZE, SIZE}, data);
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+
+	// tiles not dividing the domain
+	Buffer tiled ({SIZE, SIZE}, data);
+	auto report = overlapped_stencil<Buffer, KernelType>(tiled, TIMESTEPS, {{40, 25}}, 8);
+	EXPECT_EQ(4*6, report.tiles);
+	EXPECT_TRUE(rec == tiled);
+
+	// one tile has nothing redundant
+	Buffer whole ({SIZE, SIZE}, data);
+	report = overlapped_stencil<Buffer, KernelType>(whole, TIMESTEPS, {{SIZE, SIZE}}, 8);
+	EXPECT_EQ(1.0, report.redundancy);
+	EXPECT_TRUE(rec == whole);
+
+	// redundancy grows with the epoch length
+	Buffer shallow ({SIZE, SIZE}, data);
+	Buffer deep ({SIZE, SIZE}, data);
+	auto r1 = overlapped_stencil<Buffer, KernelType>(shallow, TIMESTEPS, {{32, 32}}, 4);
+	auto r2 = overlapped_stencil<Buffer, KernelType>(deep, TIMESTEPS, {{32, 32}}, 16);
+	EXPECT_GT(r1.redundancy, 1.0);
+	EXPECT_GT(r2.redundancy, r1.redundancy);
+}
+
+TEST(OverlappedTiling, Heat_3D){
+
+	typedef double Type;
+	const int SIZE = 30;
+	const int TIMESTEPS = 17;
+
+	typedef BufferSet<Type, 3> Buffer;
+	using KernelType = Heat_3D_k<Buffer>;
+
+	auto data  = initData<Type> (SIZE*SIZE*SIZE);
+
+	Buffer rec ({SIZE, SIZE, SIZE}, data);
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+
+	Buffer tiled ({SIZE, SIZE, SIZE}, data);
+	overlapped_stencil<Buffer, KernelType>(tiled, TIMESTEPS, {{16, 12, 10}}, 5);
+	EXPECT_TRUE(rec == tiled);
+}
+
+TEST(OverlappedTiling, Diffusion_3D){
+
+	typedef double Type;
+	const int SIZE = 30;
+	const int TIMESTEPS = 13;
+
+	typedef BufferSet<Type, 3> Buffer;
+	using KernelType = Diffusion_3D_k<Buffer>;
+
+	auto data  = initData<Type> (SIZE*SIZE*SIZE);
+	std::vector<Type> conductivity (SIZE*SIZE*SIZE);
+	for (unsigned i = 0; i < conductivity.size(); ++i) conductivity[i] = (i%7) / 7.0;
+
+	Buffer rec ({SIZE, SIZE, SIZE}, data);
+	rec.attach(conductivity);
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+
+	// scratch buffers of every shape are reused with their own read-only field
+	for (unsigned k : {2, 3}){
+		Buffer tiled ({SIZE, SIZE, SIZE}, data);
+		tiled.attach(conductivity);
+		overlapped_stencil<Buffer, KernelType>(tiled, TIMESTEPS, {{16, 12, 10}}, k);
+		EXPECT_TRUE(rec == tiled) << " k " << k;
+	}
+}
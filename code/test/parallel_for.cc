@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <atomic>
+#include <thread>
+
+#include "dispatch.h"
+
+using namespace stencil;
+
+
+// every iteration runs exactly once
+void check_loop(int begin, int end, int step, Schedule schedule, int chunk){
+
+	std::vector<std::atomic<int>> visits (end > 0? end: 1);
+	for (auto& v : visits) v = 0;
+	(void) schedule;	// not every backend uses it, see test/thread_pool.cc for the pool
+
+	P_FOR_SCHED (i, begin, end, step, schedule, chunk, {
+		visits[i]++;
+	});
+
+	for (int i = 0; i < end; ++i){
+		const bool expected = i >= begin && (i - begin) % step == 0;
+		ASSERT_EQ(expected? 1: 0, visits[i]) << " at " << i << " [" << begin << "," << end << ") step " << step << " chunk " << chunk;
+	}
+}
+
+TEST(ParallelFor, Schedules){
+
+	for (auto schedule : {Schedule::Static, Schedule::Dynamic, Schedule::Guided}){
+		for (int chunk : {0, 1, 3, 64, 1000}){
+			check_loop(0, 1000, 1, schedule, chunk);
+			check_loop(5, 777, 3, schedule, chunk);
+			check_loop(0, 1, 1, schedule, chunk);
+			check_loop(10, 10, 1, schedule, chunk);
+		}
+	}
+}
+
+TEST(ParallelFor, Nested){
+
+	const int N = 40;
+	std::vector<std::atomic<int>> visits (N*N);
+	for (auto& v : visits) v = 0;
+
+	P_FOR (i, 0, N, 1, {
+		P_FOR_SCHED (j, 0, N, 1, Schedule::Dynamic, 2, {
+			visits[i*N + j]++;
+		});
+	});
+
+	for (const auto& v : visits) ASSERT_EQ(1, v);
+}
+
+TEST(ParallelFor, Repeated){
+
+	// many short loops in a row, as the iterative engines do once per time step
+	std::atomic<long> sum (0);
+	for (int t = 0; t < 2000; ++t){
+		P_FOR (i, 0, 16, 1, { sum += i; });
+	}
+	EXPECT_EQ(2000*120, sum);
+}
+
+TEST(ParallelFor, SetThreads){
+
+	// fewer threads than the backend has, loops still visit every iteration
+	const unsigned used = set_threads(1);
+	EXPECT_GE(used, 1u);
+	for (auto schedule : {Schedule::Static, Schedule::Dynamic, Schedule::Guided}){
+		check_loop(0, 1000, 1, schedule, 7);
+	}
+	EXPECT_GE(set_threads(std::max(std::thread::hardware_concurrency(), 1u)), 1u);
+	check_loop(0, 1000, 1, Schedule::Dynamic, 7);
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <functional>
+
+#include "tools/parallelism.h"
+
+using namespace stencil::profile;
+
+
+namespace {
+
+	// time only moves when we say so
+	double now = 0;
+	double fake_clock(){
+		return now;
+	}
+}
+
+TEST(Parallelism, SpawnAndSync){
+
+	now = 0;
+	Profiler p (fake_clock, 1);
+
+	p.begin_region("region");
+	now += 1;				// serial prefix
+	p.begin_spawn();
+		now += 10;			// spawned child
+	p.end_spawn();
+	now += 4;				// continuation, in parallel with the child
+	p.sync();
+	now += 2;				// after the sync
+	p.end_region();
+
+	ASSERT_EQ(1u, p.getRegions().size());
+	const auto& r = p.getRegions()[0];
+	EXPECT_EQ(1u, r.calls);
+	EXPECT_DOUBLE_EQ(17, r.work);
+	EXPECT_DOUBLE_EQ(1 + 10 + 2, r.span);
+	EXPECT_DOUBLE_EQ(1 + 10 + 1 + 2, r.burdenedSpan);
+	EXPECT_EQ(std::vector<unsigned long>({1}), r.spawns);
+}
+
+TEST(Parallelism, Tree){
+
+	now = 0;
+	Profiler p (fake_clock, 0);
+
+	// a binary tree of depth 3, leaves of 1
+	std::function<void(int)> tree = [&] (int depth){
+		if (depth == 0) { now += 1; return; }
+		p.begin_spawn();
+		tree(depth-1);
+		p.end_spawn();
+		tree(depth-1);
+		p.sync();
+	};
+
+	for (int i = 0; i < 2; ++i){
+		p.begin_region("tree");
+		tree(3);
+		p.end_region();
+	}
+
+	const auto& r = p.getRegions()[0];
+	EXPECT_EQ(2u, r.calls);
+	EXPECT_DOUBLE_EQ(16, r.work);
+	EXPECT_DOUBLE_EQ(2, r.span);
+	EXPECT_DOUBLE_EQ(8, r.parallelism());
+	// depth counts spawned ancestors, inlined calls stay at the depth of their parent
+	EXPECT_EQ(std::vector<unsigned long>({6, 6, 2}), r.spawns);
+	EXPECT_DOUBLE_EQ(16 / (16/4. + 2), r.speedup(4));
+}
@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <cstdlib>
+#include <thread>
+
+#include "tools/perf_counters.h"
+#include "hyperspace.h"
+
+using namespace stencil;
+
+
+TEST(PerfCounters, Events){
+
+	EXPECT_EQ(std::vector<std::string>({"cycles", "l1d-misses"}), perf::detail::split("cycles,,l1d-misses"));
+
+	// whatever could be opened is a known event, at most TRACE_COUNTERS of them
+	const auto& names = perf::counter_names();
+	EXPECT_LE(names.size(), (size_t)TRACE_COUNTERS);
+	for (const auto& n : names){
+		bool known = false;
+		for (const auto& e : perf::detail::known_events()) known |= n == e.name;
+		EXPECT_TRUE(known) << n;
+	}
+}
+
+TEST(PerfCounters, Sample){
+
+	if (!perf::available()) return;		// no counters at all in this machine
+
+	trace::clear();
+	Hyperspace<2> z (0, 10, 1, -1,
+					 0, 10, 0, 1);
+	volatile double x = 0;
+	{
+		auto s = perf::sample(z, 0, 4);
+		for (int i = 0; i < 1000000; ++i) x += i;
+	}
+
+	const auto records = trace::collect();
+	ASSERT_EQ(1u, records.size());
+	EXPECT_EQ(perf::counter_names().size(), records[0].ncounters);
+	EXPECT_EQ(trace::volume(z, 0, 4), records[0].volume);
+
+	std::stringstream ss;
+	perf::report(ss);
+	std::string header, line;
+	std::getline(ss, header);
+	std::getline(ss, line);
+	EXPECT_EQ(0u, header.find("shape\tsampled\tpoints\t" + perf::counter_names()[0]));
+	EXPECT_EQ(0u, line.find("AB\t1\t"));
+}
+
+TEST(PerfCounters, ThreadsAreRecycled){
+
+	if (!perf::available()) return;
+
+	Hyperspace<1> z (0, 10, 0, 0);
+	auto work = [&] () { auto s = perf::sample(z, 0, 1); };
+
+	std::thread first (work);
+	first.join();
+	const auto count = perf::detail::Registry::instance().thread_count();
+
+	// one thread after the other, the counters of the first are reused
+	for (int i = 0; i < 50; ++i){
+		std::thread t (work);
+		t.join();
+	}
+	EXPECT_EQ(count, perf::detail::Registry::instance().thread_count());
+}
@@ -1,9 +1,15 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
+
 #include "kernel.h"
 //#include "rec_stencil_inverted_dims.h"
 //#include "rec_stencil_multiple_splits.h"
 #include "new_rec_stencil.h"
+#include "iterative_stencil.h"
+#include "wavefront.h"
+#include "overlapped_tiling.h"
+#include "roi.h"
 #include "kernels_1D.h"
 #include "kernels_2D.h"
 #include "kernels_3D.h"
@@ -215,6 +221,239 @@ TEST(Stencil2D, Blur11){
 		ASSERT_EQ( getElem(buff1, i, j, 1), getElem(buff2, i, j, 1));
 }
 
+TEST(Stencil2D, BlurN){
+
+	typedef double Type;
+	typedef BufferSet<Type, 2> Buffer;
+	typedef BlurN_k<Buffer, 9> KernelType;
+	const int W = 71, H = 53;
+	const int TIMESTEPS = 7;
+
+	auto data  = initData<Type> (W*H);
+
+	// two passes per slice in rec and it, single points in the rows of wave
+	Buffer rec ({W, H}, data);
+	Buffer it ({W, H}, data);
+	Buffer wave ({W, H}, data);
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+	iterative_stencil<Buffer, KernelType>(it, TIMESTEPS, {{16, 8}});
+	wavefront_stencil<Buffer, KernelType>(wave, TIMESTEPS, 12, 5);
+	EXPECT_TRUE(rec == it);
+	EXPECT_TRUE(rec == wave);
+
+	// the whole 9x9 box
+	std::vector<Type> ref = data, next (W*H);
+	for (int t = 0; t < TIMESTEPS; ++t){
+		for (int j = 0; j < H; ++j)
+		for (int i = 0; i < W; ++i){
+			double sum = 0.0;
+			for (int x = -4; x <= 4; ++x)
+			for (int y = -4; y <= 4; ++y){
+				if (i+x < 0 || j+y < 0 || i+x >= W || j+y >= H) continue;
+				sum += ref[i+x + (j+y)*W] * KernelType::coefficient(x, y);
+			}
+			next[i + j*W] = sum;
+		}
+		std::swap(ref, next);
+	}
+	for (int j = 0; j < H; ++j)
+	for (int i = 0; i < W; ++i)
+		ASSERT_NEAR(ref[i + j*W], getElem(rec, i, j, TIMESTEPS), 1e-9 * ref[i + j*W]) << " at " << i << "," << j;
+}
+
+TEST(Stencil2D, Resume){
+
+	typedef double Type;
+	const int SIZE = 50;
+	const int TIMESTEPS = 37;
+
+	auto data  = initData<Type> (SIZE*SIZE);
+
+	typedef BufferSet<Type, 2> Buffer;
+	using KernelType = Blur3_k<Buffer>;
+
+	Buffer once ({SIZE, SIZE}, data);
+	Buffer chunks ({SIZE, SIZE}, data);
+
+	recursive_stencil<Buffer, KernelType>(once, TIMESTEPS);
+	EXPECT_EQ(TIMESTEPS, once.getTime());
+
+	// odd chunks, the current copy flips around
+	unsigned t = 0;
+	for (auto steps : {5, 1, 12, 0, 19}){
+		t = recursive_stencil_advance<Buffer, KernelType>(chunks, steps);
+		EXPECT_EQ(t, chunks.getTime());
+		EXPECT_EQ(t%2, chunks.getCurrentCopy());
+	}
+	ASSERT_EQ(TIMESTEPS, t);
+
+	for (auto i = 0; i < SIZE; i ++)
+	for (auto j = 0; j < SIZE; j ++)
+		ASSERT_EQ( getElem(once, i, j, TIMESTEPS), getElem(chunks, i, j, TIMESTEPS));
+
+	EXPECT_EQ(0, memcmp(once.getCurrentPointer(), chunks.getCurrentPointer(), SIZE*SIZE*sizeof(Type)));
+
+	// explicit start time
+	recursive_stencil_from<Buffer, KernelType>(once, TIMESTEPS, 3);
+	recursive_stencil_advance<Buffer, KernelType>(chunks, 3);
+	EXPECT_EQ(TIMESTEPS+3, once.getTime());
+	EXPECT_EQ(0, memcmp(once.getCurrentPointer(), chunks.getCurrentPointer(), SIZE*SIZE*sizeof(Type)));
+}
+
+template <typename DataStorage>
+struct CountBlur3_k : public Blur3_k<DataStorage>{
+	static std::atomic<size_t>& count(){
+		static std::atomic<size_t> c (0);
+		return c;
+	}
+	static void withBonduaries (DataStorage& data, int i, int j, int t){
+		count()++;
+		Blur3_k<DataStorage>::withBonduaries(data, i, j, t);
+	}
+	static void withoutBonduaries (DataStorage& data, int i, int j, int t){
+		count()++;
+		Blur3_k<DataStorage>::withoutBonduaries(data, i, j, t);
+	}
+};
+
+TEST(Stencil2D, RegionOfInterest){
+
+	typedef double Type;
+	const int SIZE = 120;
+	const int TIMESTEPS = 30;
+
+	auto data  = initData<Type> (SIZE*SIZE);
+
+	typedef BufferSet<Type, 2> Buffer;
+	using KernelType = CountBlur3_k<Buffer>;
+
+	Buffer full ({SIZE, SIZE}, data);
+	recursive_stencil<Buffer, KernelType>(full, TIMESTEPS);
+
+	// centered, next to a border and in a corner (clipped cone)
+	std::vector<Hyperspace<2>> regions = {
+		Hyperspace<2>({50, 55}, {60, 62}, {0, 0}, {0, 0}),
+		Hyperspace<2>({3, 40}, {9, 41}, {0, 0}, {0, 0}),
+		Hyperspace<2>({110, 0}, {120, 7}, {0, 0}, {0, 0})
+	};
+
+	for (const auto& region : regions){
+
+		Buffer roi ({SIZE, SIZE}, data);
+		KernelType::count() = 0;
+		recursive_stencil_roi<Buffer, KernelType>(roi, TIMESTEPS, region);
+		EXPECT_EQ(TIMESTEPS, roi.getTime());
+
+		for (auto i = region.a(0); i < region.b(0); i ++)
+		for (auto j = region.a(1); j < region.b(1); j ++)
+			ASSERT_EQ( getElem(full, i, j, TIMESTEPS), getElem(roi, i, j, TIMESTEPS)) << "@ (" << i << "," << j << ")";
+
+		// work is the cone, not the grid
+		auto cone = dependency_cone<Buffer, KernelType>(roi, region, TIMESTEPS);
+		EXPECT_EQ(cone.volume(TIMESTEPS), KernelType::count());
+		EXPECT_LT(KernelType::count(), SIZE*SIZE*TIMESTEPS/2);
+	}
+
+	// the whole domain is a regular run
+	Buffer all ({SIZE, SIZE}, data);
+	recursive_stencil_roi<Buffer, KernelType>(all, TIMESTEPS, Hyperspace<2>({0, 0}, {SIZE, SIZE}, {0, 0}, {0, 0}));
+	EXPECT_EQ(0, memcmp(full.getCurrentPointer(), all.getCurrentPointer(), SIZE*SIZE*sizeof(Type)));
+}
+
+TEST(Stencil2D, Batch){
+
+	typedef double Type;
+	const int TIMESTEPS = 23;
+
+	typedef BufferSet<Type, 2> Buffer;
+	using KernelType = Blur3_k<Buffer>;
+
+	// independent grids, not all of the same size
+	std::vector<Buffer> batch;
+	std::vector<Buffer> alone;
+	for (int g = 0; g < 9; ++g){
+		const int size = 20 + 7*g;
+		auto data  = initData<Type> (size*size);
+		for (auto& v : data) v += g;
+		batch.emplace_back(std::array<size_t, 2>{{(size_t)size, (size_t)size}}, data);
+		alone.emplace_back(std::array<size_t, 2>{{(size_t)size, (size_t)size}}, data);
+	}
+
+	recursive_stencil_batch<Buffer, KernelType>(batch, TIMESTEPS);
+
+	for (unsigned g = 0; g < batch.size(); ++g){
+		recursive_stencil<Buffer, KernelType>(alone[g], TIMESTEPS);
+		EXPECT_EQ(TIMESTEPS, batch[g].getTime());
+		const int size = getW(alone[g]);
+		EXPECT_EQ(0, memcmp(alone[g].getCurrentPointer(), batch[g].getCurrentPointer(), size*size*sizeof(Type))) << " grid " << g;
+	}
+}
+
+namespace {
+
+	// the diffusion coefficient is a runtime parameter, the kernel is passed as an instance
+	template< typename DataStorage> 
+	struct Diffusion_2D_k : public Kernel<DataStorage, 2, Diffusion_2D_k<DataStorage>>{
+
+		static const unsigned int neighbours = 1;
+
+		double alpha;
+
+		explicit Diffusion_2D_k(double alpha) : alpha(alpha) {}
+
+		void withBonduaries (DataStorage& data, int i, int j, int t) const {
+			if (i == 0 || i == getW(data)-1 || j == 0 || j == getH(data)-1) { getElem(data, i, j, t+1) = getElem(data, i, j, t); return; }
+			withoutBonduaries(data, i, j, t);
+		}
+		void withoutBonduaries (DataStorage& data, int i, int j, int t) const {
+			const double lap = getElem(data, i-1, j, t) + getElem(data, i+1, j, t) + getElem(data, i, j-1, t) + getElem(data, i, j+1, t)
+							 - 4 * getElem(data, i, j, t);
+			getElem(data, i, j, t+1) = getElem(data, i, j, t) + alpha * lap;
+		}
+	};
+}
+
+TEST(Stencil2D, Parameters){
+
+	typedef double Type;
+	typedef BufferSet<Type, 2> Buffer;
+	typedef Diffusion_2D_k<Buffer> KernelType;
+	const int W = 53, H = 38;
+	const int TIMESTEPS = 27;
+
+	auto data  = initData<Type> (W*H);
+
+	// one instantiation, two coefficients
+	for (double alpha : {0.05, 0.2}){
+
+		const KernelType kernel (alpha);
+		Buffer rec ({W, H}, data);
+		Buffer blocks ({W, H}, data);
+		Buffer chunks ({W, H}, data);
+
+		recursive_stencil(rec, kernel, TIMESTEPS);
+		iterative_stencil(blocks, kernel, TIMESTEPS, {{20, 9}});
+		recursive_stencil_advance(chunks, kernel, 10);
+		recursive_stencil_advance(chunks, kernel, TIMESTEPS-10);
+		EXPECT_TRUE(rec == blocks);
+		EXPECT_TRUE(rec == chunks);
+
+		// by hand
+		std::vector<Type> ref = data, next = data;
+		for (int t = 0; t < TIMESTEPS; ++t){
+			for (int j = 1; j < H-1; ++j)
+			for (int i = 1; i < W-1; ++i){
+				const int p = i + j*W;
+				next[p] = ref[p] + alpha * (ref[p-1] + ref[p+1] + ref[p-W] + ref[p+W] - 4 * ref[p]);
+			}
+			std::swap(ref, next);
+		}
+		for (int j = 0; j < H; ++j)
+		for (int i = 0; i < W; ++i)
+			ASSERT_NEAR(ref[i + j*W], getElem(rec, i, j, TIMESTEPS), 1e-9 * W*H) << "@ (" << i << "," << j << ") alpha " << alpha;
+	}
+}
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 3D ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 TEST(Stencil3D, Translate){
@@ -301,7 +540,7 @@ TEST(Stencil3D, Heat_3D){
 
 	// Recursive
 	{
-		auto t = time_call(recursive_stencil<BufferSet<Type, 3>, Heat_3D_k<BufferSet<Type, 3>>>, recursive, TIMESTEPS);
+		auto t = time_call([&] () { recursive_stencil<BufferSet<Type, 3>, Heat_3D_k<BufferSet<Type, 3>>>(recursive, TIMESTEPS); });
 		std::cout << "recursive: " << t << "ms" <<std::endl;
 	}
 
@@ -329,6 +568,120 @@ TEST(Stencil3D, Heat_3D){
 
 }
 
+namespace {
+
+	// engines (box slices march along k, rows compute points) against point by point time steps
+	template <typename Type, template <typename> class KernelTemplate>
+	void high_order_3D(int W, int H, int D, int timeSteps){
+
+		typedef BufferSet<Type, 3> Buffer;
+		typedef KernelTemplate<Buffer> KernelType;
+
+		auto data  = initData<Type> (W*H*D);
+		const std::array<size_t, 3> extent {{(size_t)W, (size_t)H, (size_t)D}};
+		Buffer reference (extent, data);
+		Buffer rec (extent, data);
+		Buffer planes (extent, data);
+		Buffer blocks (extent, data);
+		Buffer wave (extent, data);
+
+		for (int t = 0; t < timeSteps; ++t)
+		for (int k = 0; k < D; ++k)
+		for (int j = 0; j < H; ++j)
+		for (int i = 0; i < W; ++i)
+			KernelType::withBonduaries(reference, i, j, k, t);
+
+		recursive_stencil<Buffer, KernelType>(rec, timeSteps);
+		iterative_stencil<Buffer, KernelType>(planes, timeSteps, {{W, H, 1}});
+		iterative_stencil<Buffer, KernelType>(blocks, timeSteps, {{20, 7, 11}});
+		wavefront_stencil<Buffer, KernelType>(wave, timeSteps, 8, 4);
+
+		for (int k = 0; k < D; ++k)
+		for (int j = 0; j < H; ++j)
+		for (int i = 0; i < W; ++i)
+			ASSERT_EQ(getElem(reference, i, j, k, timeSteps), getElem(rec, i, j, k, timeSteps)) << "@ (" << i << "," << j << "," << k << ")";
+		EXPECT_TRUE(reference == planes);
+		EXPECT_TRUE(reference == blocks);
+		EXPECT_TRUE(reference == wave);
+	}
+}
+
+TEST(Stencil3D, Star_13){
+
+	high_order_3D<double, Star13_3D_k>(45, 30, 38, 9);
+
+	// by hand, 4th order second derivatives along the 3 dimensions
+	typedef BufferSet<double, 3> Buffer;
+	const int SIZE = 12;
+	auto data = initData<double>(SIZE*SIZE*SIZE);
+	Buffer one ({SIZE, SIZE, SIZE}, data);
+	recursive_stencil<Buffer, Star13_3D_k<Buffer>>(one, 1);
+
+	auto at = [&] (int i, int j, int k) { return data[i + j*SIZE + k*SIZE*SIZE]; };
+	double lap = 0;
+	for (int d = 0; d < 3; ++d){
+		auto u = [&] (int m) { return at(5 + (d == 0? m: 0), 6 + (d == 1? m: 0), 4 + (d == 2? m: 0)); };
+		lap += (-u(-2) + 16*u(-1) - 30*u(0) + 16*u(1) - u(2)) / 12;
+	}
+	EXPECT_NEAR(at(5, 6, 4) + 0.0625*lap, getElem(one, 5, 6, 4, 1), 1e-9);
+	EXPECT_EQ(at(1, 6, 4), getElem(one, 1, 6, 4, 1));
+}
+
+TEST(Stencil3D, Star_25){
+	high_order_3D<float, Star25_3D_k>(40, 33, 36, 7);
+}
+
+TEST(Stencil3D, Box_27){
+	high_order_3D<double, Box_3D_k>(41, 26, 29, 10);
+}
+
+TEST(Stencil3D, Diffusion){
+
+	typedef BufferSet<double, 3> Buffer;
+	typedef Diffusion_3D_k<Buffer> KernelType;
+	const int W = 37, H = 22, D = 29;
+	const int timeSteps = 12;
+
+	// two layers of different conductivity
+	auto data = initData<double> (W*H*D);
+	std::vector<double> conductivity (W*H*D);
+	for (int p = 0; p < W*H*D; ++p) conductivity[p] = p % W < W/2? 0.1: 1.0 - (p % 7) * 0.05;
+
+	Buffer rec ({W, H, D}, data);
+	Buffer blocks ({W, H, D}, data);
+	Buffer tiles ({W, H, D}, data);
+	rec.attach(conductivity);
+	blocks.attach(conductivity);
+	tiles.attach(conductivity);
+
+	recursive_stencil<Buffer, KernelType>(rec, timeSteps);
+	iterative_stencil<Buffer, KernelType>(blocks, timeSteps, {{20, 7, 11}});
+	overlapped_stencil<Buffer, KernelType>(tiles, timeSteps, {{16, 11, 10}}, 4);
+	EXPECT_TRUE(rec == blocks);
+	EXPECT_TRUE(rec == tiles);
+
+	// by hand
+	std::vector<double> ref = data, next = data;
+	auto at = [&] (int i, int j, int k) { return i + j*W + k*W*H; };
+	for (int t = 0; t < timeSteps; ++t){
+		for (int k = 1; k < D-1; ++k)
+		for (int j = 1; j < H-1; ++j)
+		for (int i = 1; i < W-1; ++i){
+			const int p = at(i, j, k);
+			double flux = 0;
+			for (int n : {at(i-1, j, k), at(i+1, j, k), at(i, j-1, k), at(i, j+1, k), at(i, j, k-1), at(i, j, k+1)}){
+				flux += (conductivity[p] + conductivity[n]) / 2 * (ref[n] - ref[p]);
+			}
+			next[p] = ref[p] + flux / 8;
+		}
+		std::swap(ref, next);
+	}
+	for (int k = 0; k < D; ++k)
+	for (int j = 0; j < H; ++j)
+	for (int i = 0; i < W; ++i)
+		ASSERT_NEAR(ref[at(i, j, k)], getElem(rec, i, j, k, timeSteps), 1e-9 * D*W*H) << "@ (" << i << "," << j << "," << k << ")";
+}
+
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ 4D ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 namespace {
@@ -389,7 +742,7 @@ TEST(Stencil4D, AVG_4D){
 
 	// Recursive
 	{
-		auto t = time_call(recursive_stencil<BufferSet<Type, 4>, Avg_4D_k<BufferSet<Type, 4>>>, recursive, TIMESTEPS);
+		auto t = time_call([&] () { recursive_stencil<BufferSet<Type, 4>, Avg_4D_k<BufferSet<Type, 4>>>(recursive, TIMESTEPS); });
 		std::cout << "recursive: " << t << "ms" <<std::endl;
 	}
 
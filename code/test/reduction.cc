@@ -0,0 +1,266 @@
+#include <gtest/gtest.h>
+
+// threads for real, so that the reproducibility holds against a different thread count
+#define CXX_ASYNC
+
+#include "kernel.h"
+#include "new_rec_stencil.h"
+#include "reduction.h"
+#include "kernel_dsl.h"
+#include "convergence.h"
+#include "kernels_1D.h"
+#include "kernels_2D.h"
+#include "kernels_3D.h"
+
+using namespace stencil;
+using namespace stencil::example_kernels;
+using namespace stencil::example_reductions;
+
+
+template <typename Data>
+std::vector<Data> initData(int size){
+	std::vector<Data> data (size);
+	for (auto i =1; i< size; ++i) 	data[i] = i%17;
+	return data;
+}
+
+TEST(Reduction, Sum2D){
+
+	typedef double Type;
+	const int SIZE = 60;
+	const int TIMESTEPS = 25;
+
+	typedef BufferSet<Type, 2> Buffer;
+	using KernelType = Blur3_k<Buffer>;
+
+	auto data  = initData<Type> (SIZE*SIZE);
+	Buffer buff1 ({SIZE, SIZE}, data);
+	Buffer buff2 ({SIZE, SIZE}, data);
+
+	auto series = recursive_stencil_reduce<Buffer, KernelType, Sum_r<>>(buff1, TIMESTEPS);
+	ASSERT_EQ(series.size(), TIMESTEPS);
+
+	for (int t = 0; t < TIMESTEPS; ++t){
+		double sum = 0;
+		for (int i = 0; i < SIZE; ++i)
+		for (int j = 0; j < SIZE; ++j){
+			KernelType::withBonduaries(buff2, i, j, t);
+			sum += getElem(buff2, i, j, t+1);
+		}
+		EXPECT_NEAR(sum, series[t], 1e-6 * sum) << " at step " << t;
+	}
+
+	// the stencil itself is not affected
+	for (int i = 0; i < SIZE; ++i)
+	for (int j = 0; j < SIZE; ++j)
+		ASSERT_EQ(getElem(buff1, i, j, TIMESTEPS), getElem(buff2, i, j, TIMESTEPS));
+}
+
+// sum of every step, computed point by point
+template <typename Buffer, typename KernelType>
+void expect_sums(const std::vector<typename Buffer::ElementType>& data, int size, int timesteps){
+
+	Buffer buff1 ({(size_t)size, (size_t)size}, data);
+	Buffer buff2 ({(size_t)size, (size_t)size}, data);
+
+	auto series = recursive_stencil_reduce<Buffer, KernelType, Sum_r<>>(buff1, timesteps);
+	ASSERT_EQ((size_t)timesteps, series.size());
+
+	for (int t = 0; t < timesteps; ++t){
+		double sum = 0;
+		for (int i = 0; i < size; ++i)
+		for (int j = 0; j < size; ++j){
+			KernelType::withBonduaries(buff2, i, j, t);
+			sum += getElem(buff2, i, j, t+1);
+		}
+		EXPECT_NEAR(sum, series[t], 1e-9 * sum) << " at step " << t;
+	}
+}
+
+// 5 point average, the dsl gives it an interior_row
+struct Cross{
+	typedef dsl::Offsets<dsl::Offset<0,0>, dsl::Offset<-1,0>, dsl::Offset<1,0>, dsl::Offset<0,-1>, dsl::Offset<0,1>> shape;
+
+	template <typename Neighbourhood>
+	static double apply(const Neighbourhood& n){
+		double sum = 0.0;
+		for (unsigned k = 0; k < shape::count; ++k) sum += n.inside(k)? n[k]: n[0];
+		return sum / shape::count;
+	}
+};
+
+// kernels computing whole slices or rows still feed every point to the reduction
+TEST(Reduction, SlicesAndRows){
+
+	typedef double Type;
+	typedef BufferSet<Type, 2> Buffer;
+
+	const auto data = initData<Type> (64*64);
+	expect_sums<Buffer, BlurN_k<Buffer, 5>>(data, 64, 12);
+	expect_sums<Buffer, dsl::Stencil<Buffer, Cross>>(data, 64, 12);
+}
+
+TEST(Reduction, MaxChange3D){
+
+	typedef double Type;
+	const int SIZE = 20;
+	const int TIMESTEPS = 12;
+
+	typedef BufferSet<Type, 3> Buffer;
+	using KernelType = Heat_3D_k<Buffer>;
+
+	auto data  = initData<Type> (SIZE*SIZE*SIZE);
+	Buffer buff1 ({SIZE, SIZE, SIZE}, data);
+	Buffer buff2 ({SIZE, SIZE, SIZE}, data);
+
+	auto series = recursive_stencil_reduce<Buffer, KernelType, MaxChange_r<>>(buff1, TIMESTEPS);
+
+	for (int t = 0; t < TIMESTEPS; ++t){
+		double max = 0;
+		for (int i = 0; i < SIZE; ++i)
+		for (int j = 0; j < SIZE; ++j)
+		for (int k = 0; k < SIZE; ++k){
+			KernelType::withBonduaries(buff2, i, j, k, t);
+			max = MAX(max, ABS(getElem(buff2, i, j, k, t+1) - getElem(buff2, i, j, k, t)));
+		}
+		// max does not depend on the order
+		EXPECT_EQ(max, series[t]) << " at step " << t;
+	}
+}
+
+TEST(Reduction, Reproducible){
+
+	typedef double Type;
+	const int SIZE = 200;
+	const int TIMESTEPS = 40;
+
+	typedef BufferSet<Type, 2> Buffer;
+	using KernelType = Blur3_k<Buffer>;
+
+	std::vector<Type> data (SIZE*SIZE);
+	for (int i = 0; i < SIZE*SIZE; ++i) data[i] = 1.0/(i+1);
+
+	// the slices end up in other threads and finish in another order
+	auto run = [&] (unsigned threads){
+		set_threads(threads);
+		Buffer buff ({SIZE, SIZE}, data);
+		return recursive_stencil_reduce<Buffer, KernelType, SquaredChange_r<>>(buff, TIMESTEPS);
+	};
+	const auto few  = run(1);
+	const auto many = run(16);
+	set_threads(MAX_THREADS);
+
+	// reference in plain row order, equal up to rounding only
+	Buffer ref ({SIZE, SIZE}, data);
+	for (int t = 0; t < TIMESTEPS; ++t){
+		double sum = 0;
+		for (int j = 0; j < SIZE; ++j)
+		for (int i = 0; i < SIZE; ++i){
+			KernelType::withBonduaries(ref, i, j, t);
+			const double d = getElem(ref, i, j, t+1) - getElem(ref, i, j, t);
+			sum += d*d;
+		}
+		ASSERT_NEAR(sum, few[t], 1e-9 * sum) << " at step " << t;
+	}
+
+	// bitwise
+	for (int t = 0; t < TIMESTEPS; ++t){
+		EXPECT_EQ(0, memcmp(&few[t], &many[t], sizeof(Type))) << " at step " << t;
+	}
+}
+
+TEST(Reduction, Histogram){
+
+	typedef int Type;
+	const int SIZE = 50;
+
+	typedef BufferSet<Type, 2> Buffer;
+	using KernelType = Copy_k<Buffer>;
+
+	auto data  = initData<Type> (SIZE*SIZE);
+	Buffer buff ({SIZE, SIZE}, data);
+
+	auto series = recursive_stencil_reduce<Buffer, KernelType, Histogram_r<17, 0, 17>>(buff, 1);
+
+	std::array<unsigned long, 17> expected;
+	expected.fill(0);
+	for (auto v : data) expected[v]++;
+
+	for (unsigned b = 0; b < 17; ++b)
+		EXPECT_EQ(expected[b], series[0][b]);
+}
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ Convergence ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+TEST(Convergence, Jacobi){
+
+	typedef double Type;
+	const int SIZE = 40;
+
+	typedef BufferSet<Type, 2> Buffer;
+	using KernelType = Jacobi_k<Buffer>;
+
+	// hot border on one side
+	std::vector<Type> data (SIZE*SIZE, 0.0);
+	for (int i = 0; i < SIZE; ++i) data[i] = 100.0;
+
+	Buffer buff1 ({SIZE, SIZE}, data);
+	Buffer buff2 ({SIZE, SIZE}, data);
+
+	ConvergenceParams params (1e-3, 100000);
+	auto res = recursive_stencil_converge<Buffer, KernelType>(buff1, params);
+
+	EXPECT_TRUE(res.converged);
+	EXPECT_LE(res.residual, 1e-3);
+	EXPECT_GT(res.epochs, 1);
+
+	// same residual and state as running a fixed number of steps
+	recursive_stencil<Buffer, KernelType>(buff2, res.steps-1);
+	double max = 0;
+	for (int i = 0; i < SIZE; ++i)
+	for (int j = 0; j < SIZE; ++j){
+		KernelType::withBonduaries(buff2, i, j, res.steps-1);
+		max = MAX(max, ABS(getElem(buff2, i, j, res.steps) - getElem(buff2, i, j, res.steps-1)));
+	}
+	EXPECT_EQ(max, res.residual);
+
+	for (int i = 0; i < SIZE; ++i)
+	for (int j = 0; j < SIZE; ++j)
+		ASSERT_EQ(getElem(buff1, i, j, res.steps), getElem(buff2, i, j, res.steps));
+}
+
+TEST(Convergence, MaxSteps){
+
+	typedef double Type;
+	const int SIZE = 30;
+
+	typedef BufferSet<Type, 2> Buffer;
+	using KernelType = Jacobi_k<Buffer>;
+
+	std::vector<Type> data (SIZE*SIZE, 0.0);
+	for (int i = 0; i < SIZE; ++i) data[i] = 100.0;
+	Buffer buff ({SIZE, SIZE}, data);
+
+	ConvergenceParams params (1e-12, 50);
+	auto res = recursive_stencil_converge<Buffer, KernelType>(buff, params);
+
+	EXPECT_FALSE(res.converged);
+	EXPECT_EQ(50, res.steps);
+}
+
+TEST(Convergence, NextEpoch){
+
+	ConvergenceParams params (1e-6);
+
+	// decays 10x per 16 steps, 80 more steps to go
+	EXPECT_EQ(80u, detail::next_epoch(params, 16, 1e-0, 1e-1));
+
+	// the rate rounds to 1, the guess would be infinite
+	const double previous = 1.0;
+	const double residual = std::nextafter(previous, 0.0);
+	EXPECT_EQ(64u, detail::next_epoch(params, 32, previous, residual));
+
+	// no decay, or already under the tolerance: the epoch grows
+	EXPECT_EQ(64u, detail::next_epoch(params, 32, 1.0, 2.0));
+	EXPECT_EQ(64u, detail::next_epoch(params, 32, 1.0, 1e-9));
+}
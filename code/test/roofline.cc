@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include "bufferSet.h"
+#include "kernels_2D.h"
+#include "kernels_3D.h"
+#include "tools/roofline.h"
+
+using namespace stencil;
+
+
+TEST(Roofline, Model){
+
+	typedef BufferSet<double, 3> Space3D;
+	typedef BufferSet<float, 2> Space2D;
+
+	// declared by the kernel, or one multiply-add per point of the box
+	EXPECT_EQ(12, roofline::flops_per_point<example_kernels::Avg_3D_k<Space3D>>());
+	EXPECT_EQ(18, roofline::flops_per_point<example_kernels::Blur3_k<Space2D>>());
+
+	Space3D data ({{64, 64, 64}}, std::vector<double>(64*64*64, 0.0));
+	typedef example_kernels::Avg_3D_k<Space3D> K;
+	// 3 planes of 32KB fit in a large cache, not in a small one
+	EXPECT_EQ(3*8, (roofline::bytes_per_point<Space3D, K>(data, 1<<20)));
+	EXPECT_EQ(5*8, (roofline::bytes_per_point<Space3D, K>(data, 64<<10)));
+	EXPECT_EQ(3*8, (roofline::bytes_per_point<Space3D, K>(data, 0)));
+	EXPECT_EQ(3*8, (roofline::bytes_per_point<Space3D, K>(data, 192<<10)));
+
+	// a read-only field is one more read, and one more plane to keep
+	data.attach(std::vector<double>(64*64*64, 1.0));
+	EXPECT_EQ(4*8, (roofline::bytes_per_point<Space3D, K>(data, 1<<20)));
+	EXPECT_EQ(6*8, (roofline::bytes_per_point<Space3D, K>(data, 192<<10)));
+}
+
+TEST(Roofline, Report){
+
+	typedef BufferSet<double, 3> Space3D;
+	typedef example_kernels::Avg_3D_k<Space3D> K;
+	Space3D data ({{10, 10, 10}}, std::vector<double>(1000, 0.0));
+
+	const roofline::Machine m = {1e9, 1e9, 1};
+	const auto r = roofline::report<Space3D, K>("rec", 10, data, 100, m);
+
+	EXPECT_EQ(1e5, r.points);
+	EXPECT_DOUBLE_EQ(1e7, r.pointsPerSecond);
+	EXPECT_DOUBLE_EQ(12e7, r.flopRate);
+	EXPECT_DOUBLE_EQ(r.pointsPerSecond * r.bytesPerPoint, r.bandwidth);
+	EXPECT_DOUBLE_EQ(12 / r.bytesPerPoint, r.intensity);
+	EXPECT_DOUBLE_EQ(r.intensity * 1e9, r.attainable);
+	EXPECT_STREQ("bandwidth", r.bound);
+
+	std::stringstream json, csv;
+	roofline::print_json(json, r, m);
+	roofline::print_csv_header(csv);
+	roofline::print_csv(csv, r, m);
+	EXPECT_EQ(0u, json.str().find("{\"engine\":\"rec\",\"ms\":10,"));
+	EXPECT_NE(std::string::npos, json.str().find("\"bound\":\"bandwidth\""));
+
+	std::string header, line;
+	std::getline(csv, header);
+	std::getline(csv, line);
+	EXPECT_EQ(std::count(header.begin(), header.end(), ','), std::count(line.begin(), line.end(), ','));
+}
+
+TEST(Roofline, Probe){
+	const auto m = roofline::probe(1<<16, 2);
+	EXPECT_GT(m.bandwidth, 0);
+	EXPECT_GT(m.flops, 0);
+	EXPECT_GE(m.threads, 1u);
+}
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+// the pool behind the loops of CXX_ASYNC, tested whatever backend the suite is built with.
+// Its header comes first, it must not need dispatch.h
+#define CXX_ASYNC
+#include "tools/thread_pool.h"
+#include "dispatch.h"
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+using namespace stencil;
+using stencil::detail::ForPool;
+
+
+// every iteration runs exactly once
+void check_run(ForPool& pool, int begin, int end, int step, Schedule schedule, int chunk){
+
+	std::vector<std::atomic<int>> visits (end > 0? end: 1);
+	for (auto& v : visits) v = 0;
+
+	pool.run(begin, end, step, schedule, chunk, [&] (int i){
+		// uneven work, so that the dynamic schedule steals
+		if (i % 97 == 0) std::this_thread::sleep_for(std::chrono::microseconds(200));
+		visits[i]++;
+	});
+
+	for (int i = 0; i < end; ++i){
+		const bool expected = i >= begin && (i - begin) % step == 0;
+		ASSERT_EQ(expected? 1: 0, visits[i]) << " at " << i << " [" << begin << "," << end << ") step " << step << " chunk " << chunk;
+	}
+}
+
+TEST(ForPool, Schedules){
+
+	ForPool pool (4, topology::Placement::None);
+	ASSERT_EQ(4u, pool.getSize());
+
+	for (auto schedule : {Schedule::Static, Schedule::Dynamic, Schedule::Guided}){
+		for (int chunk : {0, 1, 3, 64, 1000}){
+			check_run(pool, 0, 1000, 1, schedule, chunk);
+			check_run(pool, 5, 777, 3, schedule, chunk);
+			check_run(pool, 0, 1, 1, schedule, chunk);
+			check_run(pool, 10, 10, 1, schedule, chunk);
+		}
+	}
+}
+
+TEST(ForPool, Limit){
+
+	ForPool pool (4, topology::Placement::None);
+	for (unsigned n : {2u, 1u, 3u, 100u}){
+		EXPECT_EQ(std::min(n, 4u), pool.limit(n));
+		for (auto schedule : {Schedule::Static, Schedule::Dynamic, Schedule::Guided}){
+			check_run(pool, 0, 500, 1, schedule, 0);
+		}
+	}
+	EXPECT_EQ(1u, pool.limit(0));
+}
+
+TEST(ForPool, Nested){
+
+	// the inner loops run serially in whoever runs the outer iteration
+	ForPool pool (4, topology::Placement::None);
+	const int N = 40;
+	std::vector<std::atomic<int>> visits (N*N);
+	for (auto& v : visits) v = 0;
+
+	pool.run(0, N, 1, Schedule::Dynamic, 1, [&] (int i){
+		pool.run(0, N, 1, Schedule::Dynamic, 2, [&] (int j){
+			visits[i*N + j]++;
+		});
+	});
+
+	for (const auto& v : visits) ASSERT_EQ(1, v);
+}
+
+TEST(ForPool, Busy){
+
+	// loops started while another one runs are executed by their caller
+	ForPool pool (3, topology::Placement::None);
+	const int N = 2000;
+	std::vector<std::atomic<int>> visits (2*N);
+	for (auto& v : visits) v = 0;
+
+	auto loop = [&] (int offset){
+		for (int r = 0; r < 20; ++r){
+			pool.run(0, N, 1, Schedule::Dynamic, 0, [&] (int i) { visits[offset + i]++; });
+		}
+	};
+	std::thread other (loop, N);
+	loop(0);
+	other.join();
+
+	for (const auto& v : visits) ASSERT_EQ(20, v);
+}
+
+TEST(ForPool, Macro){
+
+	// P_FOR_SCHED goes through the shared pool
+	const int N = 1000;
+	for (auto schedule : {Schedule::Static, Schedule::Dynamic, Schedule::Guided}){
+		std::vector<std::atomic<int>> visits (N);
+		for (auto& v : visits) v = 0;
+		P_FOR_SCHED (i, 0, N, 1, schedule, 5, { visits[i]++; });
+		for (const auto& v : visits) ASSERT_EQ(1, v);
+	}
+}
@@ -3,6 +3,7 @@
 
 #include <chrono>
 #include <thread>
+#include <vector>
 
 #include "timer.h" 
 
@@ -67,3 +68,63 @@ TEST(Timer, precission){
 	EXPECT_TRUE(duration >= 2000);
 
 }
+
+TEST(Timer, repetitions){
+
+	int resets = 0, calls = 0;
+	int state = 0;
+	auto t = time_repetitions(TimingConfig(2, 5), [&] (){ resets++; state = 0; }, [&] (){
+		EXPECT_EQ(0, state);		// every call starts from a reset
+		state++;
+		calls++;
+	});
+
+	EXPECT_EQ(7, resets);
+	EXPECT_EQ(7, calls);
+	EXPECT_EQ(5u, t.samples.size());
+	EXPECT_LE(t.min, t.median);
+	EXPECT_LE(t.median, t.max);
+}
+
+// a sample with only its time
+TimingSample sample(double ms){
+	TimingSample s = TimingSample();
+	s.ms = ms;
+	return s;
+}
+
+TEST(Timer, statistics){
+
+	Timing t;
+	for (double ms : {12.0, 10.0, 100.0, 13.0, 11.0}) t.samples.push_back(sample(ms));
+	timing_statistics(t);
+
+	EXPECT_EQ(12.0, t.median);
+	EXPECT_NEAR(1.4826, t.mad, 1e-9);		// deviations 0 1 1 2 88
+	EXPECT_EQ(1u, t.outliers);
+	EXPECT_TRUE(t.samples[2].outlier);
+	EXPECT_EQ(11.5, t.mean);
+	EXPECT_EQ(10.0, t.ciLow);				// few samples, the whole range
+	EXPECT_EQ(100.0, t.ciHigh);
+
+	// ranks 5 and 16 of 20
+	Timing many;
+	for (int i = 20; i > 0; --i) many.samples.push_back(sample(i));
+	timing_statistics(many);
+	EXPECT_EQ(10.5, many.median);
+	EXPECT_EQ(5.0, many.ciLow);
+	EXPECT_EQ(16.0, many.ciHigh);
+	EXPECT_EQ(0u, many.outliers);
+}
+
+TEST(Timer, rusage){
+
+	// first touch of fresh memory is a page fault per page
+	const size_t bytes = 32 << 20;
+	auto t = time_repetitions(TimingConfig(0, 2, 3.0, true), [&] (){
+		std::vector<char> fresh (bytes, 1);
+		EXPECT_EQ(1, fresh[bytes/2]);
+	});
+	EXPECT_GT(t.samples[0].minorFaults, 0);
+	EXPECT_GE(t.samples[0].voluntarySwitches, 0);
+}
@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sys/stat.h>
+
+#include "tools/topology.h"
+#include "bufferSet.h"
+#include "kernel.h"
+#include "new_rec_stencil.h"
+
+using namespace stencil::topology;
+
+
+TEST(Topology, CpuList){
+
+	EXPECT_EQ(std::vector<int>({0,1,2,3,8,10,11}), parse_cpu_list("0-3,8,10-11"));
+	EXPECT_EQ(std::vector<int>({5}), parse_cpu_list("5\n"));
+	EXPECT_TRUE(parse_cpu_list("").empty());
+}
+
+TEST(Topology, Machine){
+
+	const auto& machine = Topology::get();
+	const auto& cpus = machine.getCpus();
+	ASSERT_FALSE(cpus.empty());
+
+	for (const auto& a : cpus){
+		EXPECT_EQ(0, machine.distance(a.id, a.id));
+		for (const auto& b : cpus){
+			EXPECT_EQ(machine.distance(a.id, b.id), machine.distance(b.id, a.id));
+		}
+	}
+
+	for (auto policy : {Placement::Compact, Placement::Cores, Placement::Scatter}){
+		const auto where = machine.placement(policy, 2*cpus.size()+1);
+		ASSERT_EQ(2*cpus.size()+1, where.size());
+		// every cpu once before any is repeated
+		std::vector<int> first (where.begin(), where.begin()+cpus.size());
+		std::sort(first.begin(), first.end());
+		EXPECT_TRUE(std::unique(first.begin(), first.end()) == first.end());
+	}
+	EXPECT_TRUE(machine.placement(Placement::None, 4).empty());
+}
+
+namespace {
+
+	void write(const std::string& path, const std::string& content){
+		std::ofstream out (path);
+		out << content << "\n";
+	}
+
+	void mkdirs(const std::string& path){
+		for (size_t p = path.find('/', 1); ; p = path.find('/', p+1)){
+			mkdir(path.substr(0, p).c_str(), 0755);
+			if (p == std::string::npos) return;
+		}
+	}
+
+	// 2 packages, 2 cores each with 2 SMT siblings: cpu c and c+4 share a core
+	std::string fake_machine(){
+		const std::string root = "/tmp/stencil_topology_test";
+		write((mkdirs(root + "/cpu"), root + "/cpu/online"), "0-7");
+		for (int n = 0; n < 2; ++n){
+			mkdirs(root + "/node/node" + std::to_string(n));
+			write(root + "/node/node" + std::to_string(n) + "/cpulist", n == 0? "0-1,4-5": "2-3,6-7");
+		}
+		for (int c = 0; c < 8; ++c){
+			const std::string dir = root + "/cpu/cpu" + std::to_string(c);
+			const int core = c % 4;
+			const int package = core / 2;
+			mkdirs(dir + "/topology");
+			write(dir + "/topology/physical_package_id", std::to_string(package));
+			write(dir + "/topology/core_id", std::to_string(core % 2));
+
+			const std::string l2 = std::to_string(core) + "," + std::to_string(core+4);
+			const std::string l3 = package == 0? "0-1,4-5": "2-3,6-7";
+			const std::string levels[] = {"1", "2", "3"};
+			const std::string shared[] = {l2, l2, l3};
+			for (int i = 0; i < 3; ++i){
+				const std::string index = dir + "/cache/index" + std::to_string(i);
+				mkdirs(index);
+				write(index + "/level", levels[i]);
+				write(index + "/type", i == 0? "Data": "Unified");
+				write(index + "/shared_cpu_list", shared[i]);
+			}
+		}
+		return root;
+	}
+}
+
+TEST(Topology, FakeMachine){
+
+	const Topology machine (fake_machine());
+	ASSERT_EQ(8u, machine.getCpus().size());
+
+	EXPECT_EQ(1, machine.distance(0, 4));	// SMT siblings
+	EXPECT_EQ(3, machine.distance(0, 1));	// same L3
+	EXPECT_EQ(6, machine.distance(0, 2));	// other package
+	EXPECT_EQ(6, machine.distance(5, 7));
+
+	EXPECT_EQ(std::vector<int>({0,4,1,5,2,6,3,7}), machine.placement(Placement::Compact, 8));
+	EXPECT_EQ(std::vector<int>({0,1,2,3,4,5,6,7}), machine.placement(Placement::Cores, 8));
+	EXPECT_EQ(std::vector<int>({0,2,1,3,4,6,5,7}), machine.placement(Placement::Scatter, 8));
+	EXPECT_EQ(std::vector<int>({0,2,1}), machine.placement(Placement::Scatter, 3));
+}
+
+TEST(Topology, AffinityMask){
+
+	const Topology machine (fake_machine(), {1,2,5,6,9});
+	ASSERT_EQ(4u, machine.getCpus().size());
+
+	EXPECT_EQ(1, machine.distance(1, 5));
+	EXPECT_EQ(std::vector<int>({1,5,2,6,1}), machine.placement(Placement::Compact, 5));
+	EXPECT_EQ(std::vector<int>({1,2,5,6}), machine.placement(Placement::Cores, 4));
+	EXPECT_EQ(std::vector<int>({1,2,5,6}), machine.placement(Placement::Scatter, 4));
+
+	// the process never gets a cpu it may not run on
+	const auto allowed = allowed_cpus();
+	for (const auto& c : Topology::get().getCpus()){
+		EXPECT_TRUE(allowed.empty() || std::count(allowed.begin(), allowed.end(), c.id) == 1);
+	}
+}
+
+TEST(Topology, ZoidHome){
+
+	typedef stencil::BufferSet<double, 2> Buffer;
+	const Buffer data ({64, 64}, std::vector<double>(64*64));
+
+	// a 4x4 grid of flat zoids
+	auto zoid = [] (int x, int y){
+		return stencil::Hyperspace<2> (16*x, 16*x+16, 0, 0, 16*y, 16*y+16, 0, 0);
+	};
+	auto position = [&] (int x, int y){
+		return stencil::detail::zoid_position(data, zoid(x, y), 0, 8);
+	};
+
+	std::vector<double> seen;
+	for (int y = 0; y < 4; ++y)
+	for (int x = 0; x < 4; ++x){
+		const double p = position(x, y);
+		EXPECT_EQ(p, position(x, y));
+		EXPECT_GE(p, 0.0);
+		EXPECT_LT(p, 1.0);
+		// Z order: the quadrant comes first
+		EXPECT_EQ((y/2)*2 + x/2, (int)(p*4)) << x << "," << y;
+		seen.push_back(p);
+	}
+	std::sort(seen.begin(), seen.end());
+	EXPECT_TRUE(std::unique(seen.begin(), seen.end()) == seen.end());
+
+	// on the fake machine a quadrant takes one core, side by side quadrants one package
+	const Topology machine (fake_machine());
+	const auto order = machine.placement(Placement::Compact, 8);
+	for (int y = 0; y < 4; ++y)
+	for (int x = 0; x < 3; ++x){
+		const int a = home_cpu(position(x, y), order);
+		const int b = home_cpu(position(x+1, y), order);
+		EXPECT_LE(machine.distance(a, b), x == 1? 3: 1) << x << "," << y;
+	}
+
+	// without placement, anywhere
+	EXPECT_EQ(-1, home_cpu(0.3, std::vector<int>()));
+	if (!std::getenv("STENCIL_AFFINITY")){
+		EXPECT_EQ(-1, stencil::detail::zoid_home(data, zoid(1, 2), 0, 8));
+	}
+}
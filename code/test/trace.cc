@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <thread>
+#include <sstream>
+
+#include "tools/trace.h"
+#include "hyperspace.h"
+
+using namespace stencil;
+
+
+TEST(Trace, Threads){
+
+	trace::clear();
+	const auto event = trace::intern("work");
+	EXPECT_EQ(event, trace::intern("work"));
+	EXPECT_NE(event, trace::intern("other"));
+
+	const int Threads = 4;
+	const int N = 1000;
+	std::vector<std::thread> threads;
+	for (int i = 0; i < Threads; ++i){
+		threads.emplace_back([=] (){
+			for (int n = 0; n < N; ++n){
+				trace::Scope s (event, n, n+1, i);
+			}
+		});
+	}
+	for (auto& t : threads) t.join();
+
+	const auto records = trace::collect();
+	ASSERT_EQ((size_t)Threads*N, records.size());
+
+	std::vector<int> perArg (Threads, 0);
+	for (unsigned i = 0; i < records.size(); ++i){
+		EXPECT_EQ(event, records[i].event);
+		EXPECT_LE(records[i].start, records[i].end);
+		if (i){
+			EXPECT_LE(records[i-1].start, records[i].start);
+		}
+		perArg[records[i].arg]++;
+	}
+	for (int c : perArg) EXPECT_EQ(N, c);
+}
+
+TEST(Trace, RingKeepsTheLatest){
+
+	trace::clear();
+	const auto event = trace::intern("ring");
+	const int N = TRACE_BUFFER + 100;
+	for (int n = 0; n < N; ++n){
+		trace::Scope s (event, n, n);
+	}
+
+	const auto records = trace::collect();
+	ASSERT_EQ((size_t)TRACE_BUFFER, records.size());
+	EXPECT_EQ(100, records.front().t0);
+	EXPECT_EQ(N-1, records.back().t0);
+}
+
+TEST(Trace, BuffersAreRecycled){
+
+	trace::clear();
+	const auto event = trace::intern("short");
+	{
+		trace::Scope s (event, 0, 1);
+	}
+	std::thread([&] (){ trace::Scope s (event, 0, 1); }).join();
+	const auto before = trace::buffers();
+
+	// one thread after another, each takes the buffer the previous one left
+	const int N = 50;
+	for (int n = 0; n < N; ++n){
+		std::thread([&] (){ trace::Scope s (event, n, n+1); }).join();
+	}
+	EXPECT_EQ(before, trace::buffers());
+	EXPECT_EQ((size_t)N+2, trace::collect().size());
+}
+
+TEST(Trace, Dump){
+
+	trace::clear();
+	Hyperspace<2> z (0, 10, 1, -1,
+	                 0, 10, 0, 1);
+	{
+		trace::Scope s (trace::intern("base"), 3, 5, 0, 2, trace::shape(z));
+	}
+
+	std::stringstream ss;
+	trace::dump(ss);
+	std::string header, line;
+	std::getline(ss, header);
+	std::getline(ss, line);
+	EXPECT_NE(std::string::npos, line.find("base\tAB\t3\t5"));
+}
+
+TEST(Trace, ChromeTrace){
+
+	trace::clear();
+	Hyperspace<1> z (0, 10, 1, -1);
+	const auto event = trace::intern("base");
+	{
+		trace::Scope s (event, 0, 2, 0, 1, trace::shape(z), trace::volume(z, 0, 2));
+	}
+	std::thread([&] (){
+		trace::Task task;
+		trace::Scope s (event, 2, 4);
+	}).join();
+
+	const auto records = trace::collect();
+	ASSERT_EQ(3u, records.size());
+	EXPECT_EQ(18u, records[0].volume);		// 10 + 8
+	EXPECT_EQ(0u, records[0].task);
+	// the task record ends last, but starts before the event inside it
+	EXPECT_NE(0u, records[1].task);
+	EXPECT_EQ(records[1].task, records[2].task);
+
+	std::stringstream ss;
+	trace::chrome_trace(ss);
+	const auto json = ss.str();
+	EXPECT_EQ(0u, json.find("{\"displayTimeUnit\""));
+	EXPECT_NE(std::string::npos, json.find("\"ph\":\"X\""));
+	EXPECT_NE(std::string::npos, json.find("\"shape\":\"A\",\"t0\":0,\"t1\":2,\"volume\":18"));
+	EXPECT_NE(std::string::npos, json.find("\"spawned\":true"));
+	EXPECT_EQ(json.size()-3, json.rfind("]}"));
+}
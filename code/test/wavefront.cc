@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include "kernel.h"
+#include "new_rec_stencil.h"
+#include "wavefront.h"
+#include "kernels_1D.h"
+#include "kernels_2D.h"
+#include "kernels_3D.h"
+
+using namespace stencil;
+using namespace stencil::example_kernels;
+
+
+template <typename Data>
+std::vector<Data> initData(int size){
+	std::vector<Data> data (size);
+	for (auto i =1; i< size; ++i) 	data[i] = i%19;
+	return data;
+}
+
+TEST(Wavefront, Row){
+
+	typedef double Type;
+	const int SIZE = 40;
+
+	typedef BufferSet<Type, 2> Buffer;
+	using KernelType = Blur3_k<Buffer>;
+
+	auto data  = initData<Type> (SIZE*SIZE);
+	Buffer rows ({SIZE, SIZE}, data);
+	Buffer points ({SIZE, SIZE}, data);
+
+	for (int j = 0; j < SIZE; ++j){
+		solve_row<KernelType>(rows, 0, SIZE, j, 0);
+		for (int i = 0; i < SIZE; ++i) KernelType::withBonduaries(points, i, j, 0);
+	}
+	EXPECT_TRUE(rows == points);
+}
+
+TEST(Wavefront, AVG_1D){
+
+	typedef double Type;
+	const int SIZE = 1000;
+	const int TIMESTEPS = 53;
+
+	typedef BufferSet<Type, 1> Buffer;
+	using KernelType = Avg_1D_k<Buffer>;
+
+	auto data  = initData<Type> (SIZE);
+	Buffer rec ({SIZE}, data);
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+
+	for (int height : {1, 4, 10, 60}){
+		Buffer wave ({SIZE}, data);
+		wavefront_stencil<Buffer, KernelType>(wave, TIMESTEPS, 64, height);
+		EXPECT_EQ(TIMESTEPS, wave.getTime());
+		EXPECT_TRUE(rec == wave) << " height " << height;
+	}
+}
+
+TEST(Wavefront, Blur_2D){
+
+	typedef double Type;
+	const int SIZE = 150;
+	const int TIMESTEPS = 27;
+
+	typedef BufferSet<Type, 2> Buffer;
+	using KernelType = Blur3_k<Buffer>;
+
+	auto data  = initData<Type> (SIZE*SIZE);
+	Buffer rec ({SIZE, SIZE}, data);
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+
+	// widths not dividing the domain, and too narrow for the band
+	for (int width : {7, 33, 150, 400}){
+		Buffer wave ({SIZE, SIZE}, data);
+		wavefront_stencil<Buffer, KernelType>(wave, TIMESTEPS, width, 8);
+		EXPECT_TRUE(rec == wave) << " width " << width;
+	}
+}
+
+TEST(Wavefront, Heat_3D){
+
+	typedef double Type;
+	const int SIZE = 32;
+	const int TIMESTEPS = 21;
+
+	typedef BufferSet<Type, 3> Buffer;
+	using KernelType = Heat_3D_k<Buffer>;
+
+	auto data  = initData<Type> (SIZE*SIZE*SIZE);
+	Buffer rec ({SIZE, SIZE, SIZE}, data);
+	recursive_stencil<Buffer, KernelType>(rec, TIMESTEPS);
+
+	Buffer wave ({SIZE, SIZE, SIZE}, data);
+	wavefront_stencil<Buffer, KernelType>(wave, TIMESTEPS, 10, 5);
+	EXPECT_TRUE(rec == wave);
+}